@@ -0,0 +1,309 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#if defined(__i386__) || defined(__x86_64__)
+#   include <x86intrin.h>
+#endif
+
+/**
+ * Cheap timestamp counter. This is the TSC on x86, the virtual counter on
+ * aarch64, and the steady clock in nanoseconds elsewhere.
+ */
+static inline uint64_t benchReadCycles()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t t;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static inline uint64_t benchReadNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Put the FPU in the state a plugin host normally gives us.
+ * Executables linked with -ffast-math get flush-to-zero enabled at startup,
+ * shared objects do not, so undo it to keep denormal timings honest.
+ */
+static inline void benchResetFloatingPointMode()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    _mm_setcsr(_mm_getcsr() & ~0x8040u);
+#endif
+}
+
+/**
+ * Prevent the compiler from optimizing away a computed result.
+ */
+template <class T> static inline void benchKeep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Check a float for NaN or infinity. This does not use std::isfinite,
+ * which -ffast-math is allowed to fold to true.
+ */
+static inline bool benchIsFinite(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x7f800000u) != 0x7f800000u;
+}
+
+struct BenchMeasure {
+    double nsPerSample = 0;
+    double cyclesPerSample = 0;
+};
+
+/**
+ * Time `fn(count)` over `repeats` runs, and keep the median run.
+ */
+template <class Fn>
+BenchMeasure benchMeasure(Fn &&fn, uint64_t samplesPerRun, unsigned repeats)
+{
+    std::vector<double> ns(repeats), cycles(repeats);
+
+    fn(); // warm up caches and branch predictors
+
+    for (unsigned r = 0; r < repeats; ++r) {
+        uint64_t t0 = benchReadNanoseconds();
+        uint64_t c0 = benchReadCycles();
+        fn();
+        uint64_t c1 = benchReadCycles();
+        uint64_t t1 = benchReadNanoseconds();
+        ns[r] = double(t1 - t0) / samplesPerRun;
+        cycles[r] = double(c1 - c0) / samplesPerRun;
+    }
+
+    std::nth_element(ns.begin(), ns.begin() + repeats / 2, ns.end());
+    std::nth_element(cycles.begin(), cycles.begin() + repeats / 2, cycles.end());
+
+    BenchMeasure m;
+    m.nsPerSample = ns[repeats / 2];
+    m.cyclesPerSample = cycles[repeats / 2];
+    return m;
+}
+
+///
+enum BenchSignal {
+    kBenchSignalSilent,
+    kBenchSignalNormal,
+    kBenchSignalDenormal,
+};
+
+static const char *const benchSignalNames[] = {"silent", "normal", "denormal"};
+
+/**
+ * Generate a mono test input of the given kind.
+ * The normal signal is a guitar-like decaying pluck sequence over noise,
+ * the denormal one is noise in the subnormal range which keeps all the
+ * filter states near zero.
+ */
+static inline void benchGenerateSignal(BenchSignal kind, float *data, uint32_t frames, double sampleRate)
+{
+    uint32_t seed = 1;
+    auto noise = [&seed]() -> float {
+        seed = seed * 1664525u + 1013904223u;
+        return (int32_t)seed * (1.0f / 2147483648.0f);
+    };
+
+    switch (kind) {
+    case kBenchSignalSilent:
+        std::fill(data, data + frames, 0.0f);
+        break;
+    case kBenchSignalNormal: {
+        double phase = 0;
+        double env = 0;
+        uint32_t period = (uint32_t)(0.25 * sampleRate);
+        for (uint32_t i = 0; i < frames; ++i) {
+            if (i % period == 0)
+                env = 1;
+            env *= 0.9999;
+            phase += 2 * M_PI * 110.0 / sampleRate;
+            phase -= (phase > 2 * M_PI) ? 2 * M_PI : 0;
+            data[i] = (float)(env * (0.5 * std::sin(phase) + 0.25 * std::sin(3 * phase))) + 1e-3f * noise();
+        }
+        break;
+    }
+    case kBenchSignalDenormal:
+        for (uint32_t i = 0; i < frames; ++i)
+            data[i] = 1e-39f * noise();
+        break;
+    }
+}
+
+///
+/**
+ * Minimal writer of a flat JSON result list.
+ */
+class BenchJsonWriter {
+public:
+    explicit BenchJsonWriter(FILE *stream) : fStream(stream) {}
+
+    void begin(const char *tool)
+    {
+        fprintf(fStream, "{\n  \"tool\": \"%s\",\n  \"version\": 1,\n  \"results\": [", tool);
+    }
+
+    void end()
+    {
+        fprintf(fStream, "\n  ]\n}\n");
+        fflush(fStream);
+    }
+
+    void beginResult()
+    {
+        fprintf(fStream, "%s\n    {", fCount++ ? "," : "");
+        fFields = 0;
+    }
+
+    void endResult()
+    {
+        fprintf(fStream, "}");
+    }
+
+    void field(const char *key, const char *value)
+    {
+        fprintf(fStream, "%s\"%s\": \"%s\"", fFields++ ? ", " : "", key, value);
+    }
+
+    void field(const char *key, double value)
+    {
+        fprintf(fStream, "%s\"%s\": %.6g", fFields++ ? ", " : "", key, value);
+    }
+
+    void field(const char *key, long value)
+    {
+        fprintf(fStream, "%s\"%s\": %ld", fFields++ ? ", " : "", key, value);
+    }
+
+private:
+    FILE *fStream = nullptr;
+    unsigned fCount = 0;
+    unsigned fFields = 0;
+};
+
+/**
+ * Read back the results of a file written by BenchJsonWriter.
+ * This only understands the flat, one object per line layout of the writer.
+ */
+static inline std::vector<std::map<std::string, std::string>> benchReadJsonResults(const char *path)
+{
+    std::vector<std::map<std::string, std::string>> results;
+
+    FILE *stream = fopen(path, "r");
+    if (!stream)
+        return results;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), stream)) {
+        const char *p = strchr(line, '{');
+        if (!p || !strchr(p, '}') || !strstr(p, "\"name\""))
+            continue;
+
+        std::map<std::string, std::string> result;
+        while ((p = strchr(p, '"'))) {
+            const char *keyEnd = strchr(p + 1, '"');
+            if (!keyEnd)
+                break;
+            std::string key(p + 1, keyEnd);
+            p = keyEnd + 1;
+            while (*p == ':' || *p == ' ')
+                ++p;
+            std::string value;
+            if (*p == '"') {
+                const char *valueEnd = strchr(p + 1, '"');
+                if (!valueEnd)
+                    break;
+                value.assign(p + 1, valueEnd);
+                p = valueEnd + 1;
+            }
+            else {
+                const char *valueEnd = p + strcspn(p, ",}");
+                value.assign(p, valueEnd);
+                p = valueEnd;
+            }
+            result[key] = value;
+        }
+        results.push_back(result);
+    }
+
+    fclose(stream);
+    return results;
+}
+
+/**
+ * Write a mono WAV file of 32-bit float samples, such as an impulse
+ * response for the cabinet.
+ */
+static inline bool benchWriteWav(const char *path, const float *data, uint32_t frames, uint32_t sampleRate)
+{
+    FILE *stream = fopen(path, "wb");
+    if (!stream)
+        return false;
+
+    auto put = [stream](uint32_t value, unsigned bytes) {
+        for (unsigned i = 0; i < bytes; ++i)
+            fputc((value >> (8 * i)) & 0xff, stream);
+    };
+    uint32_t dataBytes = frames * 4;
+    fwrite("RIFF", 1, 4, stream);
+    put(36 + dataBytes, 4);
+    fwrite("WAVEfmt ", 1, 8, stream);
+    put(16, 4);
+    put(3, 2); // floating point
+    put(1, 2);
+    put(sampleRate, 4);
+    put(sampleRate * 4, 4);
+    put(4, 2);
+    put(32, 2);
+    fwrite("data", 1, 4, stream);
+    put(dataBytes, 4);
+    for (uint32_t i = 0; i < frames; ++i) {
+        uint32_t bits;
+        memcpy(&bits, &data[i], 4);
+        put(bits, 4);
+    }
+
+    return fclose(stream) == 0;
+}
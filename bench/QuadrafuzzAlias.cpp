@@ -0,0 +1,524 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "BenchCommon.hpp"
+#include "BenchFFT.hpp"
+#include "QuadrafuzzDSP.hpp"
+#include <memory>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+typedef std::complex<double> cdouble;
+
+/* the sample rate of the host, which `-r` changes */
+static double gSampleRate = 44100;
+static constexpr uint32_t kAnalysisFrames = 16384;
+static constexpr uint32_t kLeadInFrames = 4096;
+static constexpr uint32_t kBlockSize = 256;
+/* the automatic oversampling settles before the analysis, over whole
+ * periods of the test signals */
+static constexpr uint32_t kAutoSettleFrames = 4 * kAnalysisFrames;
+
+/* the reference renders at 64x: the core runs 8x internally, at a host
+ * rate which is 8 times the analysis rate */
+static constexpr unsigned kReferenceHostRatio = 8;
+static constexpr unsigned kReferenceOversampling = 8;
+static constexpr unsigned kReferenceTaps = 2048;
+static constexpr double kReferenceKaiserBeta = 12.0;
+
+struct DriveSetting {
+    const char *name;
+    float drive[QuadrafuzzDSP::Bands];
+};
+
+static const DriveSetting driveSettings[] = {
+    {"0.0", {0.0, 0.0, 0.0, 0.0}},
+    {"0.5", {0.5, 0.5, 0.5, 0.5}},
+    {"1.0", {1.0, 1.0, 1.0, 1.0}},
+    {"default", {0.6, 0.8, 0.5, 0.6}},
+};
+
+/**
+ * A periodic test signal made of tones which are exactly on the bins of
+ * the analysis window, at odd bin numbers. With a single tone, this puts
+ * every aliased harmonic apart from the true harmonics.
+ */
+struct TestSignal {
+    std::string name;
+    std::vector<uint32_t> bins;
+    double amplitude = 0.5;
+
+    std::vector<float> generate(uint32_t frames, unsigned upRatio = 1) const
+    {
+        std::vector<float> data(frames * upRatio);
+        for (uint32_t i = 0; i < frames * upRatio; ++i) {
+            double s = 0;
+            for (uint32_t bin : bins)
+                s += std::sin(2 * M_PI * bin * i / (kAnalysisFrames * upRatio));
+            data[i] = amplitude * s;
+        }
+        return data;
+    }
+};
+
+static uint32_t oddBinForFrequency(double frequency)
+{
+    uint32_t bin = (uint32_t)(frequency * kAnalysisFrames / gSampleRate);
+    return bin | 1;
+}
+
+static std::vector<TestSignal> makeSweepSignals(unsigned steps)
+{
+    std::vector<TestSignal> signals;
+    const double f1 = 50, f2 = 16000;
+    for (unsigned s = 0; s < steps; ++s) {
+        double f = f1 * std::pow(f2 / f1, double(s) / (steps - 1));
+        TestSignal sig;
+        sig.bins.push_back(oddBinForFrequency(f));
+        char name[64];
+        sprintf(name, "sine/%.0f", sig.bins[0] * gSampleRate / kAnalysisFrames);
+        sig.name = name;
+        signals.push_back(sig);
+    }
+    return signals;
+}
+
+static TestSignal makeMultiToneSignal()
+{
+    TestSignal sig;
+    sig.name = "multitone";
+    sig.bins = {oddBinForFrequency(220), oddBinForFrequency(1330), oddBinForFrequency(3770)};
+    sig.amplitude = 0.3;
+    return sig;
+}
+
+///
+static void setupCore(QuadrafuzzDSP &dsp, double sampleRate, const DriveSetting &ds, int oversampling)
+{
+    // the defaults of QuadrafuzzPlugin::initParameter, but the drives
+    dsp.setSampleRate(sampleRate);
+    dsp.setParameterValue(pIdBypass, 0);
+    dsp.setParameterValue(pIdInputGain, 0);
+    dsp.setParameterValue(pIdOutputGain, 0);
+    dsp.setParameterValue(pIdDryGain, -40);
+    dsp.setParameterValue(pIdWetGain, 0);
+    for (unsigned b = 0; b < QuadrafuzzDSP::Bands; ++b)
+        dsp.setParameterValue(pIdDrive + b, ds.drive[b]);
+    dsp.setParameterValue(pIdOversampling, oversampling);
+}
+
+static void runCore(QuadrafuzzDSP &dsp, const float *input, float *output, uint32_t frames)
+{
+    for (uint32_t i = 0; i < frames; i += kBlockSize)
+        dsp.run(&input[i], &output[i], std::min(kBlockSize, frames - i));
+}
+
+static std::vector<float> renderCore(const TestSignal &sig, const DriveSetting &ds, int oversampling)
+{
+    const uint32_t leadIn = kLeadInFrames + ((oversampling == OversamplingAuto) ? kAutoSettleFrames : 0);
+    const uint32_t frames = leadIn + kAnalysisFrames;
+    std::vector<float> input = sig.generate(frames);
+    std::vector<float> output(frames);
+
+    std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+    setupCore(*dsp, gSampleRate, ds, oversampling);
+    runCore(*dsp, input.data(), output.data(), frames);
+
+    return std::vector<float>(output.begin() + leadIn, output.end());
+}
+
+/**
+ * Windowed sinc, linear phase, for the conversions to and from the host
+ * rate of the reference.
+ */
+static std::vector<double> designReferenceKernel()
+{
+    std::vector<double> h(kReferenceTaps);
+    const double center = 0.5 * (kReferenceTaps - 1);
+    const double fc = 0.5 / kReferenceHostRatio;
+    const double i0beta = DSP::besseli(kReferenceKaiserBeta);
+    double sum = 0;
+    for (unsigned i = 0; i < kReferenceTaps; ++i) {
+        double t = i - center;
+        double sinc = (t == 0) ? 2 * fc : std::sin(2 * M_PI * fc * t) / (M_PI * t);
+        double r = t / center;
+        double window = DSP::besseli(kReferenceKaiserBeta * std::sqrt(std::max(0.0, 1 - r * r))) / i0beta;
+        h[i] = sinc * window;
+        sum += h[i];
+    }
+    for (double &c : h)
+        c /= sum;
+    return h;
+}
+
+static std::vector<float> renderReference(const TestSignal &sig, const DriveSetting &ds)
+{
+    static const std::vector<double> h = designReferenceKernel();
+    const unsigned R = kReferenceHostRatio;
+    const uint32_t frames = kLeadInFrames + kAnalysisFrames;
+
+    // upsample, as a convolution of the zero-stuffed input
+    std::vector<float> input = sig.generate(frames);
+    std::vector<float> upInput(frames * R);
+    for (uint32_t n = 0; n < frames * R; ++n) {
+        double s = 0;
+        for (uint32_t k = n % R; k < kReferenceTaps && k <= n; k += R)
+            s += h[k] * input[(n - k) / R];
+        upInput[n] = R * s;
+    }
+
+    std::vector<float> upOutput(frames * R);
+    std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+    setupCore(*dsp, gSampleRate * R, ds, kReferenceOversampling);
+    runCore(*dsp, upInput.data(), upOutput.data(), frames * R);
+
+    // filter and decimate
+    std::vector<float> output(kAnalysisFrames);
+    for (uint32_t i = 0; i < kAnalysisFrames; ++i) {
+        uint32_t n = (kLeadInFrames + i) * R;
+        double s = 0;
+        for (uint32_t k = 0; k < kReferenceTaps && k <= n; ++k)
+            s += h[k] * upOutput[n - k];
+        output[i] = s;
+    }
+
+    return output;
+}
+
+///
+struct Analysis {
+    double aliasDb = 0;
+    double thdnDb = 0;
+    double deviationDb = 0;
+};
+
+static double energyToDb(double ratio)
+{
+    return 10 * std::log10(std::max(ratio, 1e-30));
+}
+
+/**
+ * Residual energy of `y`, delayed by `d` samples, against `r`.
+ */
+static double residualEnergy(const std::vector<cdouble> &y, const std::vector<cdouble> &r, double d)
+{
+    const size_t N = y.size();
+    double e = 0;
+    for (size_t k = 1; k < N / 2; ++k) {
+        double w = 2 * M_PI * k / N;
+        e += std::norm(y[k] * std::polar(1.0, w * d) - r[k]);
+    }
+    return e;
+}
+
+/**
+ * Compare against the reference, after finding the relative latency
+ * which best aligns the two, including the fractional part.
+ */
+static double deviationFromReference(const std::vector<cdouble> &y, const std::vector<cdouble> &r)
+{
+    const size_t N = y.size();
+
+    std::vector<cdouble> xcorr(N);
+    for (size_t k = 0; k < N; ++k)
+        xcorr[k] = y[k] * std::conj(r[k]);
+    benchFFT(xcorr.data(), N, true);
+
+    size_t peak = 0;
+    for (size_t i = 1; i < N; ++i)
+        peak = (xcorr[i].real() > xcorr[peak].real()) ? i : peak;
+    double delay = (peak < N / 2) ? double(peak) : double(peak) - N;
+
+    // golden section search of the fractional delay
+    const double phi = 0.5 * (std::sqrt(5.0) - 1);
+    double a = delay - 1, b = delay + 1;
+    for (unsigned iter = 0; iter < 40; ++iter) {
+        double c = b - phi * (b - a), d = a + phi * (b - a);
+        if (residualEnergy(y, r, c) < residualEnergy(y, r, d))
+            b = d;
+        else
+            a = c;
+    }
+
+    double reference = 0;
+    for (size_t k = 1; k < N / 2; ++k)
+        reference += std::norm(r[k]);
+
+    return residualEnergy(y, r, 0.5 * (a + b)) / reference;
+}
+
+static Analysis analyze(const TestSignal &sig, const std::vector<float> &output, const std::vector<float> &reference)
+{
+    const size_t N = kAnalysisFrames;
+    std::vector<cdouble> y = benchSpectrum(output.data(), N);
+    std::vector<cdouble> r = benchSpectrum(reference.data(), N);
+
+    Analysis an;
+    an.deviationDb = energyToDb(deviationFromReference(y, r));
+
+    if (sig.bins.size() == 1) {
+        const uint32_t fundamental = sig.bins[0];
+        std::vector<bool> harmonic(N / 2, false);
+        for (uint32_t bin = fundamental; bin < N / 2; bin += fundamental)
+            harmonic[bin] = true;
+
+        double total = 0, alias = 0;
+        for (size_t k = 1; k < N / 2; ++k) {
+            double e = std::norm(y[k]);
+            total += e;
+            alias += harmonic[k] ? 0 : e;
+        }
+        an.aliasDb = energyToDb(alias / total);
+        an.thdnDb = energyToDb((total - std::norm(y[fundamental])) / total);
+    }
+
+    return an;
+}
+
+///
+static double measureCpu(int oversampling, const DriveSetting &ds)
+{
+    const uint32_t frames = 16384;
+    std::vector<float> input = makeMultiToneSignal().generate(frames);
+    std::vector<float> output(frames);
+
+    std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+    setupCore(*dsp, gSampleRate, ds, oversampling);
+
+    BenchMeasure m = benchMeasure([&]() {
+        runCore(*dsp, input.data(), output.data(), frames);
+        benchKeep(output[0]);
+    }, frames, 9);
+
+    return m.nsPerSample;
+}
+
+struct Summary {
+    std::string mode;
+    std::string drive;
+    double cpuNsPerSample = 0;
+    double aliasMeanDb = 0;
+    double aliasMaxDb = -300;
+    double deviationMaxDb = -300;
+    double multitoneDeviationDb = 0;
+};
+
+static int compareWithBaseline(const char *path, const std::vector<Summary> &summaries, double tolerance)
+{
+    std::vector<std::map<std::string, std::string>> baseline = benchReadJsonResults(path);
+    if (baseline.empty()) {
+        fprintf(stderr, "Cannot read the baseline results: %s\n", path);
+        return 1;
+    }
+
+    int failures = 0;
+    for (const Summary &s : summaries) {
+        for (const std::map<std::string, std::string> &b : baseline) {
+            auto get = [&b](const char *key) -> std::string {
+                auto it = b.find(key);
+                return (it != b.end()) ? it->second : std::string();
+            };
+            if (get("name") != "summary" || get("mode") != s.mode || get("drive") != s.drive)
+                continue;
+
+            const std::pair<const char *, double> checks[] = {
+                {"alias_max_db", s.aliasMaxDb},
+                {"deviation_max_db", s.deviationMaxDb},
+                {"multitone_deviation_db", s.multitoneDeviationDb},
+            };
+            for (const auto &check : checks) {
+                double expected = atof(get(check.first).c_str());
+                if (check.second > expected + tolerance) {
+                    fprintf(stderr, "Regression: mode %s, drive %s: %s is %.1f dB, baseline %.1f dB\n",
+                            s.mode.c_str(), s.drive.c_str(), check.first, check.second, expected);
+                    ++failures;
+                }
+            }
+        }
+    }
+
+    return failures ? 1 : 0;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: quadrafuzz-alias [-o output.json] [-t table.txt] [-q] [-r rate] [-b baseline.json] [-d tolerance]\n"
+            "  -o  write the JSON results to a file instead of stdout\n"
+            "  -t  write the table of CPU versus aliasing to a file\n"
+            "  -q  quick run, with fewer steps in the sine sweep\n"
+            "  -r  the sample rate of the host (default 44100)\n"
+            "  -b  compare the results with a previous JSON output, and fail\n"
+            "      if some mode got worse than the tolerance\n"
+            "  -d  the tolerance of the comparison, in dB (default 1)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outputPath = nullptr;
+    const char *tablePath = nullptr;
+    const char *baselinePath = nullptr;
+    double tolerance = 1.0;
+    unsigned sweepSteps = 16;
+
+    for (int c; (c = getopt(argc, argv, "o:t:qr:b:d:h")) != -1;) {
+        switch (c) {
+        case 'o':
+            outputPath = optarg;
+            break;
+        case 't':
+            tablePath = optarg;
+            break;
+        case 'q':
+            sweepSteps = 6;
+            break;
+        case 'r':
+            gSampleRate = atof(optarg);
+            break;
+        case 'b':
+            baselinePath = optarg;
+            break;
+        case 'd':
+            tolerance = atof(optarg);
+            break;
+        default:
+            usage();
+            return (c == 'h') ? 0 : 1;
+        }
+    }
+
+    FILE *stream = stdout;
+    if (outputPath && !(stream = fopen(outputPath, "w"))) {
+        perror(outputPath);
+        return 1;
+    }
+
+    benchResetFloatingPointMode();
+
+    std::vector<TestSignal> sweep = makeSweepSignals(sweepSteps);
+    TestSignal multitone = makeMultiToneSignal();
+
+    std::vector<Summary> summaries;
+    BenchJsonWriter json(stream);
+    json.begin("quadrafuzz-alias");
+
+    for (const DriveSetting &ds : driveSettings) {
+        std::vector<std::vector<float>> sweepReferences;
+        for (const TestSignal &sig : sweep)
+            sweepReferences.push_back(renderReference(sig, ds));
+        std::vector<float> multitoneReference = renderReference(multitone, ds);
+
+        for (const auto &ov : OversamplingValues) {
+            Summary summary;
+            summary.mode = ov.second;
+            summary.drive = ds.name;
+
+            double aliasSum = 0;
+            for (size_t s = 0; s < sweep.size(); ++s) {
+                const TestSignal &sig = sweep[s];
+                Analysis an = analyze(sig, renderCore(sig, ds, ov.first), sweepReferences[s]);
+
+                aliasSum += std::pow(10.0, 0.1 * an.aliasDb);
+                summary.aliasMaxDb = std::max(summary.aliasMaxDb, an.aliasDb);
+                summary.deviationMaxDb = std::max(summary.deviationMaxDb, an.deviationDb);
+
+                json.beginResult();
+                json.field("name", sig.name.c_str());
+                json.field("mode", ov.second);
+                json.field("drive", ds.name);
+                json.field("alias_db", an.aliasDb);
+                json.field("thdn_db", an.thdnDb);
+                json.field("deviation_db", an.deviationDb);
+                json.endResult();
+            }
+            summary.aliasMeanDb = energyToDb(aliasSum / sweep.size());
+
+            Analysis an = analyze(multitone, renderCore(multitone, ds, ov.first), multitoneReference);
+            summary.multitoneDeviationDb = an.deviationDb;
+
+            json.beginResult();
+            json.field("name", multitone.name.c_str());
+            json.field("mode", ov.second);
+            json.field("drive", ds.name);
+            json.field("deviation_db", an.deviationDb);
+            json.endResult();
+
+            summaries.push_back(summary);
+        }
+    }
+
+    // the cost of a fixed mode does not depend on the drives, unlike the
+    // automatic one
+    for (const auto &ov : OversamplingValues) {
+        if (ov.first == OversamplingAuto) {
+            for (const DriveSetting &ds : driveSettings) {
+                double cpu = measureCpu(ov.first, ds);
+                for (Summary &s : summaries)
+                    s.cpuNsPerSample = (s.mode == ov.second && s.drive == ds.name) ? cpu : s.cpuNsPerSample;
+            }
+            continue;
+        }
+        double cpu = measureCpu(ov.first, driveSettings[3]);
+        for (Summary &s : summaries)
+            s.cpuNsPerSample = (s.mode == ov.second) ? cpu : s.cpuNsPerSample;
+    }
+
+    for (const Summary &s : summaries) {
+        json.beginResult();
+        json.field("name", "summary");
+        json.field("mode", s.mode.c_str());
+        json.field("drive", s.drive.c_str());
+        json.field("cpu_ns_per_sample", s.cpuNsPerSample);
+        json.field("alias_mean_db", s.aliasMeanDb);
+        json.field("alias_max_db", s.aliasMaxDb);
+        json.field("deviation_max_db", s.deviationMaxDb);
+        json.field("multitone_deviation_db", s.multitoneDeviationDb);
+        json.endResult();
+    }
+
+    json.end();
+
+    if (stream != stdout)
+        fclose(stream);
+
+    FILE *table = tablePath ? fopen(tablePath, "w") : stderr;
+    if (!table) {
+        perror(tablePath);
+        return 1;
+    }
+    fprintf(table, "%-8s %-8s %12s %12s %12s %12s %12s\n",
+            "mode", "drive", "cpu ns/smp", "alias mean", "alias max", "sweep dev", "multi dev");
+    for (const Summary &s : summaries) {
+        fprintf(table, "%-8s %-8s %12.2f %9.1f dB %9.1f dB %9.1f dB %9.1f dB\n",
+                s.mode.c_str(), s.drive.c_str(), s.cpuNsPerSample, s.aliasMeanDb,
+                s.aliasMaxDb, s.deviationMaxDb, s.multitoneDeviationDb);
+    }
+    if (table != stderr)
+        fclose(table);
+
+    if (baselinePath)
+        return compareWithBaseline(baselinePath, summaries, tolerance);
+
+    return 0;
+}
@@ -0,0 +1,1068 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "BenchCommon.hpp"
+#include "QuadrafuzzDSP.hpp"
+#include <memory>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+static unsigned gRepeats = 15;
+static const char *gFilter = nullptr;
+static unsigned gFailures = 0;
+static constexpr double kSampleRate = 44100;
+
+static bool benchSelected(const char *name)
+{
+    return !gFilter || strstr(name, gFilter);
+}
+
+static void writeMeasure(BenchJsonWriter &json, const BenchMeasure &m)
+{
+    json.field("ns_per_sample", m.nsPerSample);
+    json.field("cycles_per_sample", m.cyclesPerSample);
+}
+
+///
+template <int Ratio, int FIRSize>
+static void benchOversampler(BenchJsonWriter &json)
+{
+    typedef DSP::Oversampler<Ratio, FIRSize> Oversampler;
+    constexpr uint32_t frames = 4096;
+
+    std::unique_ptr<Oversampler> os(new Oversampler);
+    std::vector<float> input(frames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), frames, kSampleRate);
+
+    auto report = [&json](const char *name, const BenchMeasure &m) {
+        json.beginResult();
+        json.field("name", name);
+        json.field("ratio", (long)Ratio);
+        json.field("taps", (long)FIRSize);
+        writeMeasure(json, m);
+        json.endResult();
+    };
+
+    if (benchSelected("fir_up_upsample")) {
+        report("fir_up_upsample", benchMeasure([&]() {
+            float acc = 0;
+            for (uint32_t i = 0; i < frames; ++i)
+                acc += os->fir.up.upsample(input[i]);
+            benchKeep(acc);
+        }, frames, gRepeats));
+    }
+
+    if (benchSelected("fir_up_pad") && Ratio > 1) {
+        report("fir_up_pad", benchMeasure([&]() {
+            float acc = 0;
+            for (uint32_t i = 0; i < frames; ++i) {
+                for (uint32_t o = 1; o < Ratio; ++o)
+                    acc += os->fir.up.pad(o);
+            }
+            benchKeep(acc);
+        }, frames * (Ratio - 1), gRepeats));
+    }
+
+    if (benchSelected("fir_down_process")) {
+        report("fir_down_process", benchMeasure([&]() {
+            float acc = 0;
+            for (uint32_t i = 0; i < frames; ++i)
+                acc += os->fir.down.process(input[i]);
+            benchKeep(acc);
+        }, frames, gRepeats));
+    }
+
+    if (benchSelected("fir_down_store")) {
+        report("fir_down_store", benchMeasure([&]() {
+            for (uint32_t i = 0; i < frames; ++i)
+                os->fir.down.store(input[i]);
+            benchKeep(os->fir.down.x[0]);
+        }, frames, gRepeats));
+    }
+}
+
+static void benchBiquad(BenchJsonWriter &json)
+{
+    if (!benchSelected("biquad_process"))
+        return;
+
+    constexpr uint32_t frames = 4096;
+    std::vector<float> input(frames), output(frames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), frames, kSampleRate);
+
+    WebCore::Biquad filter;
+    filter.setBandpassParams(587.0 / (0.5 * kSampleRate), M_SQRT1_2);
+
+    BenchMeasure m = benchMeasure([&]() {
+        filter.process(input.data(), output.data(), frames);
+        benchKeep(output[0]);
+    }, frames, gRepeats);
+
+    json.beginResult();
+    json.field("name", "biquad_process");
+    writeMeasure(json, m);
+    json.endResult();
+}
+
+static void benchDistort(BenchJsonWriter &json)
+{
+    if (!benchSelected("distort"))
+        return;
+
+    constexpr uint32_t frames = 4096;
+    std::vector<float> input(frames), buffer(frames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), frames, kSampleRate);
+
+    const QuadrafuzzKernels &kernels = selectKernels();
+    QuadrafuzzDSP::ShaperCoefficients sc = QuadrafuzzDSP::shaperCoefficients(0.6f);
+
+    BenchMeasure m = benchMeasure([&]() {
+        std::copy(input.begin(), input.end(), buffer.begin());
+        kernels.distort(buffer.data(), sc.gain, sc.scale, frames);
+        benchKeep(buffer[0]);
+    }, frames, gRepeats);
+
+    json.beginResult();
+    json.field("name", "distort");
+    writeMeasure(json, m);
+    json.endResult();
+}
+
+/**
+ * The kernels of every instruction set which the CPU supports, with their
+ * largest deviation from the scalar reference.
+ */
+static void benchKernels(BenchJsonWriter &json)
+{
+    constexpr uint32_t frames = 4096;
+    constexpr uint32_t over = 8;
+    typedef QuadrafuzzKernels::BiquadGroup BiquadGroup;
+
+    std::vector<float> input(over * frames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), over * frames, kSampleRate);
+
+    const QuadrafuzzKernels &reference = *findKernels("scalar");
+    QuadrafuzzDSP::ShaperCoefficients sc = QuadrafuzzDSP::shaperCoefficients(0.6f);
+
+    // the band filters, at 2x
+    BiquadGroup filters = {};
+    static const double frequencies[BiquadGroup::Lanes] = {147, 587, 2490, 4980};
+    for (unsigned l = 0; l < BiquadGroup::Lanes; ++l) {
+        WebCore::Biquad biquad;
+        double f = frequencies[l] / kSampleRate;
+        if (l == 0)
+            biquad.setLowpassParams(f, M_SQRT1_2);
+        else if (l < 3)
+            biquad.setBandpassParams(f, M_SQRT1_2);
+        else
+            biquad.setHighpassParams(f, M_SQRT1_2);
+        WebCore::Biquad::Coefficients c = biquad.getCoefficients();
+        filters.b0[l] = c.b0;
+        filters.b1[l] = c.b1;
+        filters.b2[l] = c.b2;
+        filters.a1[l] = c.a1;
+        filters.a2[l] = c.a2;
+    }
+
+    // the same kernel as the 8x oversampler
+    QuadrafuzzDSP::Oversampler8x oversampler;
+
+    enum { kScale, kMultiplyAdd, kDistort, kBiquadGroup, kUpsample, kDownsample, kDot, kSpectrumMac, kKernelCount };
+    static const char *const kernelNames[kKernelCount] = {
+        "scale", "multiply_add", "distort", "biquad_group", "upsample_8x", "downsample_8x", "dot", "spectrum_mac",
+    };
+
+    // runs a kernel on fresh state, into an output of `over * frames`
+    auto runKernel = [&](const QuadrafuzzKernels &k, unsigned kernel, std::vector<float> &out) {
+        switch (kernel) {
+        case kScale:
+            k.scale(out.data(), input.data(), 0.5f, frames);
+            break;
+        case kMultiplyAdd:
+            k.multiplyAdd(out.data(), input.data(), 0.5f, frames);
+            break;
+        case kDistort:
+            std::copy(input.begin(), input.begin() + frames, out.begin());
+            k.distort(out.data(), sc.gain, sc.scale, frames);
+            break;
+        case kBiquadGroup: {
+            BiquadGroup group = filters;
+            float *outputs[BiquadGroup::Lanes];
+            for (unsigned l = 0; l < BiquadGroup::Lanes; ++l)
+                outputs[l] = &out[l * frames];
+            static_assert(BiquadGroup::Lanes <= over, "the output is too small");
+            k.biquadGroups(&group, 1, input.data(), outputs, frames);
+            break;
+        }
+        case kUpsample:
+            oversampler.reset();
+            k.upsample(QuadrafuzzKernels::FirState{oversampler.fir.up.c, oversampler.fir.up.x, QuadrafuzzDSP::Oversampler8x::KernelTaps, oversampler.fir.up.m, &oversampler.fir.up.h},
+                       over, input.data(), out.data(), frames);
+            break;
+        case kDownsample:
+            oversampler.reset();
+            k.downsample(QuadrafuzzKernels::FirState{oversampler.fir.down.c, oversampler.fir.down.x, QuadrafuzzDSP::Oversampler8x::KernelTaps, oversampler.fir.down.m, &oversampler.fir.down.h},
+                         over, input.data(), out.data(), frames);
+            break;
+        case kDot:
+            out[0] = k.dot(input.data(), &input[frames], frames);
+            break;
+        case kSpectrumMac: {
+            // the spectra of the convolver, of `frames / 2` bins
+            const uint32_t bins = frames / 2;
+            std::copy(input.begin(), input.begin() + frames, out.begin());
+            k.spectrumMultiplyAdd(&out[0], &out[bins], &input[frames], &input[frames + bins],
+                                  &input[2 * frames], &input[2 * frames + bins], bins);
+            break;
+        }
+        }
+    };
+
+    std::vector<float> expected(over * frames), actual(over * frames);
+
+    for (const char *const *name = listKernels(); *name; ++name) {
+        const QuadrafuzzKernels *k = findKernels(*name);
+        if (!k)
+            continue;
+
+        for (unsigned kernel = 0; kernel < kKernelCount; ++kernel) {
+            char caseName[64];
+            sprintf(caseName, "kernel/%s/%s", *name, kernelNames[kernel]);
+            if (!benchSelected(caseName))
+                continue;
+
+            std::fill(expected.begin(), expected.end(), 0);
+            std::fill(actual.begin(), actual.end(), 0);
+            runKernel(reference, kernel, expected);
+            runKernel(*k, kernel, actual);
+            double maxError = 0;
+            for (size_t i = 0; i < expected.size(); ++i)
+                maxError = std::max(maxError, (double)std::fabs(expected[i] - actual[i]));
+
+            BenchMeasure m = benchMeasure([&]() {
+                runKernel(*k, kernel, actual);
+                benchKeep(actual[0]);
+            }, frames, gRepeats);
+
+            json.beginResult();
+            json.field("name", "kernel");
+            json.field("isa", *name);
+            json.field("kernel", kernelNames[kernel]);
+            writeMeasure(json, m);
+            json.field("max_error", maxError);
+            json.endResult();
+        }
+    }
+}
+
+///
+template <unsigned NBands>
+static void setDefaultParameters(QuadrafuzzEngine<NBands> &dsp)
+{
+    typedef QuadrafuzzEngine<NBands> Engine;
+
+    // the defaults of QuadrafuzzPlugin::initParameter
+    dsp.setParameterValue(pIdBypass, 0);
+    dsp.setParameterValue(pIdInputGain, 0);
+    dsp.setParameterValue(pIdOutputGain, 0);
+    dsp.setParameterValue(pIdDryGain, -40);
+    dsp.setParameterValue(pIdWetGain, 0);
+    for (unsigned b = 0; b < Engine::Bands; ++b)
+        dsp.setParameterValue(pIdDrive + b, Engine::getBand(b).drive);
+    dsp.setParameterValue(Engine::ParameterOversampling, 1);
+}
+
+static void benchRun(BenchJsonWriter &json)
+{
+    static const uint32_t blockSizes[] = {1, 16, 64, 256, 4096};
+    constexpr uint32_t totalFrames = 16384;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+
+    for (const auto &ov : OversamplingValues) {
+        if (!isOversamplingRatio(ov.first))
+            continue;
+        for (unsigned sig = 0; sig < 3; ++sig) {
+            benchGenerateSignal((BenchSignal)sig, input.data(), totalFrames, kSampleRate);
+
+            for (uint32_t blockSize : blockSizes) {
+                char name[64];
+                sprintf(name, "run/%s/%ux/%u", benchSignalNames[sig], ov.first, blockSize);
+                if (!benchSelected(name))
+                    continue;
+
+                std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+                dsp->setSampleRate(kSampleRate);
+                setDefaultParameters(*dsp);
+                dsp->setParameterValue(pIdOversampling, ov.first);
+
+                BenchMeasure m = benchMeasure([&]() {
+                    for (uint32_t i = 0; i < totalFrames; i += blockSize)
+                        dsp->run(&input[i], &output[i], blockSize);
+                    benchKeep(output[0]);
+                }, totalFrames, gRepeats);
+
+                json.beginResult();
+                json.field("name", "run");
+                json.field("signal", benchSignalNames[sig]);
+                json.field("ratio", (long)ov.first);
+                json.field("block_size", (long)blockSize);
+                writeMeasure(json, m);
+                json.field("realtime_factor", 1e9 / (m.nsPerSample * kSampleRate));
+                json.endResult();
+            }
+        }
+    }
+}
+
+/* the share of the frames which ran at each ratio */
+static void writeRatioShares(BenchJsonWriter &json, const uint64_t *ratioFrames)
+{
+    uint64_t allFrames = 0;
+    for (const auto &ov : OversamplingValues)
+        allFrames += isOversamplingRatio(ov.first) ? ratioFrames[ov.first] : 0;
+
+    for (const auto &ov : OversamplingValues) {
+        if (!isOversamplingRatio(ov.first))
+            continue;
+        char key[64];
+        sprintf(key, "share_%ux", ov.first);
+        json.field(key, allFrames ? double(ratioFrames[ov.first]) / allFrames : 0.0);
+    }
+}
+
+static void benchAuto(BenchJsonWriter &json)
+{
+    struct DriveSetting {
+        const char *name;
+        float drive;
+    };
+    static const DriveSetting driveSettings[] = {
+        {"clean", 0.0f},
+        {"light", 0.02f},
+        {"default", -1},
+    };
+    constexpr uint32_t blockSize = 256;
+    constexpr uint32_t totalFrames = 65536;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), totalFrames, kSampleRate);
+
+    for (const DriveSetting &ds : driveSettings) {
+        char name[64];
+        sprintf(name, "auto/%s", ds.name);
+        if (!benchSelected(name))
+            continue;
+
+        std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+        dsp->setSampleRate(kSampleRate);
+        dsp->setBlockSize(blockSize);
+        dsp->waitForWorker();
+        setDefaultParameters(*dsp);
+        dsp->setParameterValue(pIdOversampling, OversamplingAuto);
+        for (unsigned b = 0; ds.drive >= 0 && b < QuadrafuzzDSP::Bands; ++b)
+            dsp->setParameterValue(pIdDrive + b, ds.drive);
+
+        // count the frames which ran at each ratio, by the telemetry
+        uint64_t ratioFrames[OversamplingValues.back().first + 1] = {};
+        BenchMeasure m = benchMeasure([&]() {
+            TelemetryRecord rec;
+            for (uint32_t i = 0; i < totalFrames; i += blockSize) {
+                dsp->run(&input[i], &output[i], blockSize);
+                while (dsp->getTelemetry().read(rec))
+                    ratioFrames[std::min<uint32_t>(rec.oversampling, OversamplingValues.back().first)] += rec.frames;
+            }
+            benchKeep(output[0]);
+        }, totalFrames, gRepeats);
+
+        json.beginResult();
+        json.field("name", "auto");
+        json.field("drive", ds.name);
+        json.field("block_size", (long)blockSize);
+        writeMeasure(json, m);
+        writeRatioShares(json, ratioFrames);
+        json.endResult();
+    }
+}
+
+static void benchBudget(BenchJsonWriter &json)
+{
+    // in percent of the block duration; 8x takes about 0.4% with AVX2
+    static const float budgets[] = {0.5f, 0.25f, 0.1f};
+    constexpr uint32_t blockSize = 256;
+    constexpr uint32_t totalFrames = 262144;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), totalFrames, kSampleRate);
+
+    for (float budget : budgets) {
+        char name[64];
+        sprintf(name, "budget/%g", budget);
+        if (!benchSelected(name))
+            continue;
+
+        std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+        dsp->setSampleRate(kSampleRate);
+        dsp->setBlockSize(blockSize);
+        dsp->waitForWorker();
+        setDefaultParameters(*dsp);
+        dsp->setParameterValue(pIdOversampling, 8);
+        dsp->setParameterValue(pIdCpuBudget, budget);
+
+        uint64_t ratioFrames[OversamplingValues.back().first + 1] = {};
+        BenchMeasure m = benchMeasure([&]() {
+            TelemetryRecord rec;
+            for (uint32_t i = 0; i < totalFrames; i += blockSize) {
+                dsp->run(&input[i], &output[i], blockSize);
+                while (dsp->getTelemetry().read(rec))
+                    ratioFrames[std::min<uint32_t>(rec.oversampling, OversamplingValues.back().first)] += rec.frames;
+            }
+            benchKeep(output[0]);
+        }, totalFrames, gRepeats);
+
+        json.beginResult();
+        json.field("name", "budget");
+        json.field("budget", budget);
+        json.field("block_size", (long)blockSize);
+        writeMeasure(json, m);
+        writeRatioShares(json, ratioFrames);
+        json.field("effective", dsp->getParameterValue(pIdEffectiveOversampling));
+        json.endResult();
+    }
+}
+
+static void benchRate(BenchJsonWriter &json)
+{
+    static const double sampleRates[] = {44100, 48000, 88200, 96000, 176400, 192000};
+    constexpr uint32_t blockSize = 256;
+    constexpr uint32_t totalFrames = 16384;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+
+    for (double sampleRate : sampleRates) {
+        char name[64];
+        sprintf(name, "rate/%.0f", sampleRate);
+        if (!benchSelected(name))
+            continue;
+
+        benchGenerateSignal(kBenchSignalNormal, input.data(), totalFrames, sampleRate);
+
+        std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+        dsp->setSampleRate(sampleRate);
+        dsp->setBlockSize(blockSize);
+        dsp->waitForWorker();
+        setDefaultParameters(*dsp);
+        dsp->setParameterValue(pIdOversampling, OversamplingFixedRate);
+
+        BenchMeasure m = benchMeasure([&]() {
+            for (uint32_t i = 0; i < totalFrames; i += blockSize)
+                dsp->run(&input[i], &output[i], blockSize);
+            benchKeep(output[0]);
+        }, totalFrames, gRepeats);
+
+        // the cost of a second of audio, which is what the host rate changes
+        json.beginResult();
+        json.field("name", "rate");
+        json.field("sample_rate", sampleRate);
+        json.field("ratio", dsp->getParameterValue(pIdEffectiveOversampling));
+        json.field("block_size", (long)blockSize);
+        writeMeasure(json, m);
+        json.field("ms_per_second", 1e-6 * m.nsPerSample * sampleRate);
+        json.endResult();
+    }
+}
+
+static void benchChunk(BenchJsonWriter &json)
+{
+    // 0 processes the whole block as one chunk
+    static const uint32_t chunkSizes[] = {16, 32, 64, 128, 256, 512, 1024, 0};
+    constexpr uint32_t blockSize = 4096;
+    constexpr uint32_t totalFrames = 16384;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), totalFrames, kSampleRate);
+
+    for (const auto &ov : OversamplingValues) {
+        if (!isOversamplingRatio(ov.first))
+            continue;
+        for (uint32_t chunkSize : chunkSizes) {
+            char name[64];
+            sprintf(name, "chunk/%ux/%u", ov.first, chunkSize);
+            if (!benchSelected(name))
+                continue;
+
+            std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+            dsp->setSampleRate(kSampleRate);
+            dsp->setBlockSize(blockSize);
+            dsp->setChunkSize(chunkSize);
+            dsp->waitForWorker();
+            setDefaultParameters(*dsp);
+            dsp->setParameterValue(pIdOversampling, ov.first);
+
+            BenchMeasure m = benchMeasure([&]() {
+                for (uint32_t i = 0; i < totalFrames; i += blockSize)
+                    dsp->run(&input[i], &output[i], blockSize);
+                benchKeep(output[0]);
+            }, totalFrames, gRepeats);
+
+            json.beginResult();
+            json.field("name", "chunk");
+            json.field("ratio", (long)ov.first);
+            json.field("block_size", (long)blockSize);
+            json.field("chunk_size", (long)(chunkSize ? chunkSize : blockSize));
+            writeMeasure(json, m);
+            json.endResult();
+        }
+    }
+}
+
+template <unsigned NBands>
+static void benchBandCount(BenchJsonWriter &json)
+{
+    typedef QuadrafuzzEngine<NBands> Engine;
+
+    constexpr uint32_t blockSize = 512;
+    constexpr uint32_t totalFrames = 16384;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), totalFrames, kSampleRate);
+
+    for (const auto &ov : OversamplingValues) {
+        if (!isOversamplingRatio(ov.first))
+            continue;
+        char name[64];
+        sprintf(name, "bands/%u/%ux", NBands, ov.first);
+        if (!benchSelected(name))
+            continue;
+
+        std::unique_ptr<Engine> dsp(new Engine);
+        dsp->setSampleRate(kSampleRate);
+        dsp->setBlockSize(blockSize);
+        dsp->waitForWorker();
+        setDefaultParameters(*dsp);
+        dsp->setParameterValue(Engine::ParameterOversampling, ov.first);
+
+        BenchMeasure m = benchMeasure([&]() {
+            for (uint32_t i = 0; i < totalFrames; i += blockSize)
+                dsp->run(&input[i], &output[i], blockSize);
+            benchKeep(output[0]);
+        }, totalFrames, gRepeats);
+
+        json.beginResult();
+        json.field("name", "bands");
+        json.field("bands", (long)NBands);
+        json.field("ratio", (long)ov.first);
+        json.field("block_size", (long)blockSize);
+        writeMeasure(json, m);
+        json.endResult();
+    }
+}
+
+static void benchBands(BenchJsonWriter &json)
+{
+    benchBandCount<2>(json);
+    benchBandCount<4>(json);
+    benchBandCount<6>(json);
+    benchBandCount<8>(json);
+}
+
+template <unsigned NBands>
+static void benchMuteCount(BenchJsonWriter &json)
+{
+    typedef QuadrafuzzEngine<NBands> Engine;
+
+    constexpr unsigned ratio = 4;
+    constexpr uint32_t blockSize = 512;
+    constexpr uint32_t totalFrames = 16384;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), totalFrames, kSampleRate);
+
+    // mute the highest bands first
+    for (unsigned active = 0; active <= NBands; ++active) {
+        char name[64];
+        sprintf(name, "mute/%u/%u", NBands, active);
+        if (!benchSelected(name))
+            continue;
+
+        std::unique_ptr<Engine> dsp(new Engine);
+        dsp->setSampleRate(kSampleRate);
+        dsp->setBlockSize(blockSize);
+        dsp->waitForWorker();
+        setDefaultParameters(*dsp);
+        dsp->setParameterValue(Engine::ParameterOversampling, ratio);
+        for (unsigned b = active; b < NBands; ++b)
+            dsp->setParameterValue(Engine::ParameterMute + b, 1);
+
+        // let the mutes fade out
+        for (uint32_t i = 0; i < totalFrames; i += blockSize)
+            dsp->run(&input[i], &output[i], blockSize);
+
+        BenchMeasure m = benchMeasure([&]() {
+            for (uint32_t i = 0; i < totalFrames; i += blockSize)
+                dsp->run(&input[i], &output[i], blockSize);
+            benchKeep(output[0]);
+        }, totalFrames, gRepeats);
+
+        json.beginResult();
+        json.field("name", "mute");
+        json.field("bands", (long)NBands);
+        json.field("active_bands", (long)active);
+        json.field("ratio", (long)ratio);
+        json.field("block_size", (long)blockSize);
+        writeMeasure(json, m);
+        json.endResult();
+    }
+}
+
+static void benchMute(BenchJsonWriter &json)
+{
+    benchMuteCount<4>(json);
+    benchMuteCount<8>(json);
+}
+
+static void benchRamp(BenchJsonWriter &json)
+{
+    constexpr uint32_t blockSize = 512;
+    constexpr uint32_t totalFrames = 16384;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), totalFrames, kSampleRate);
+
+    for (const auto &ov : OversamplingValues) {
+        if (!isOversamplingRatio(ov.first))
+            continue;
+        char name[64];
+        sprintf(name, "ramp/%ux", ov.first);
+        if (!benchSelected(name))
+            continue;
+
+        std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+        dsp->setSampleRate(kSampleRate);
+        setDefaultParameters(*dsp);
+        dsp->setParameterValue(pIdOversampling, ov.first);
+
+        // with a change every block, gains and drives ramp all the time
+        unsigned counter = 0;
+        auto runAll = [&](bool automate) {
+            for (uint32_t i = 0; i < totalFrames; i += blockSize) {
+                if (automate) {
+                    float x = (++counter & 1) ? 1 : 0;
+                    for (unsigned p = pIdInputGain; p <= pIdWetGain; ++p)
+                        dsp->setParameterValue(p, -6 * x);
+                    for (unsigned b = 0; b < QuadrafuzzDSP::Bands; ++b)
+                        dsp->setParameterValue(pIdDrive + b, 0.2f + 0.6f * x);
+                }
+                dsp->run(&input[i], &output[i], blockSize);
+            }
+            benchKeep(output[0]);
+        };
+
+        BenchMeasure off = benchMeasure([&]() { runAll(false); }, totalFrames, gRepeats);
+        BenchMeasure on = benchMeasure([&]() { runAll(true); }, totalFrames, gRepeats);
+
+        json.beginResult();
+        json.field("name", "ramp");
+        json.field("ratio", (long)ov.first);
+        json.field("block_size", (long)blockSize);
+        writeMeasure(json, on);
+        json.field("overhead_percent", 100 * (on.nsPerSample / off.nsPerSample - 1));
+        json.endResult();
+    }
+}
+
+static void benchSwitch(BenchJsonWriter &json)
+{
+    constexpr uint32_t blockSize = 64;
+    // longer than the transition, which is 20 ms
+    constexpr uint32_t windowFrames = 2048;
+
+    std::vector<float> input(2 * windowFrames), output(2 * windowFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), 2 * windowFrames, kSampleRate);
+
+    for (const auto &from : OversamplingValues) {
+        for (const auto &to : OversamplingValues) {
+            if (from.first == to.first || !isOversamplingRatio(from.first) || !isOversamplingRatio(to.first))
+                continue;
+
+            char name[64];
+            sprintf(name, "switch/%ux/%ux", from.first, to.first);
+            if (!benchSelected(name))
+                continue;
+
+            std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+            dsp->setSampleRate(kSampleRate);
+            setDefaultParameters(*dsp);
+
+            // the window after a switch, and the worst block in it
+            double worstBlockNs = 0;
+            auto runWindow = [&](unsigned oversampling, const float *in, float *out) {
+                dsp->setParameterValue(pIdOversampling, oversampling);
+                for (uint32_t i = 0; i < windowFrames; i += blockSize) {
+                    uint64_t t0 = benchReadNanoseconds();
+                    dsp->run(&in[i], &out[i], blockSize);
+                    worstBlockNs = std::max(worstBlockNs, (double)(benchReadNanoseconds() - t0));
+                }
+            };
+
+            runWindow(from.first, &input[0], &output[0]);
+            BenchMeasure steady = benchMeasure([&]() {
+                runWindow(to.first, &input[0], &output[0]);
+                benchKeep(output[0]);
+            }, windowFrames, gRepeats);
+            worstBlockNs = 0;
+            BenchMeasure m = benchMeasure([&]() {
+                runWindow(to.first, &input[0], &output[0]);
+                runWindow(from.first, &input[windowFrames], &output[windowFrames]);
+                benchKeep(output[0]);
+            }, 2 * windowFrames, gRepeats);
+
+            json.beginResult();
+            json.field("name", "switch");
+            json.field("from", (long)from.first);
+            json.field("to", (long)to.first);
+            json.field("block_size", (long)blockSize);
+            writeMeasure(json, m);
+            json.field("worst_block_ns", worstBlockNs);
+            json.field("deadline_ns", 1e9 * blockSize / kSampleRate);
+            json.field("steady_ns_per_sample", steady.nsPerSample);
+            json.endResult();
+        }
+    }
+}
+
+/**
+ * The convolution of the cabinet, for impulse responses up to the longest.
+ * The worst block, against the mean, tells how evenly the work is spread,
+ * and the error is against a direct convolution.
+ */
+static void benchCabinet(BenchJsonWriter &json)
+{
+    static const double lengths[] = {0.05, 0.1, 0.25, 0.5, 1, 2};
+    constexpr uint32_t blockSize = 64;
+    constexpr uint32_t totalFrames = 16384;
+    constexpr uint32_t checkFrames = 4096;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), totalFrames, kSampleRate);
+
+    for (double length : lengths) {
+        char name[64];
+        sprintf(name, "cabinet/%gs", length);
+        if (!benchSelected(name))
+            continue;
+
+        // a decaying noise, like the room of a cabinet
+        const uint32_t taps = (uint32_t)(length * kSampleRate);
+        std::vector<float> response(taps);
+        uint32_t seed = 1;
+        for (uint32_t t = 0; t < taps; ++t) {
+            seed = seed * 1664525u + 1013904223u;
+            response[t] = (int32_t)seed * (1.0f / 2147483648.0f) * std::exp(-6.9f * t / taps);
+        }
+
+        const QuadrafuzzKernels &kernels = selectKernels();
+        std::unique_ptr<QuadrafuzzConvolver> convolver(new QuadrafuzzConvolver(kernels, response.data(), taps));
+
+        convolver->process(input.data(), output.data(), checkFrames);
+        double maxError = 0;
+        for (uint32_t i = 0; i < checkFrames; i += 7) {
+            double sum = 0;
+            for (uint32_t t = 0, n = std::min(i + 1, taps); t < n; ++t)
+                sum += (double)response[t] * input[i - t];
+            maxError = std::max(maxError, std::fabs(sum - output[i]));
+        }
+        if (maxError > 1e-4) {
+            fprintf(stderr, "FAIL %s: the convolution deviates by %g from the direct sum\n", name, maxError);
+            ++gFailures;
+        }
+
+        // the time of each block of a partition period is its fastest over
+        // the periods and the runs, so that the worst one shows the work of
+        // the block and not a preemption
+        std::vector<double> blockNs(convolver->getPartitionSize() / blockSize, HUGE_VAL);
+        BenchMeasure m = benchMeasure([&]() {
+            for (uint32_t i = 0; i < totalFrames; i += blockSize) {
+                uint64_t t0 = benchReadNanoseconds();
+                convolver->process(&input[i], &output[i], blockSize);
+                double ns = benchReadNanoseconds() - t0;
+                double &slot = blockNs[(i / blockSize) % blockNs.size()];
+                slot = std::min(slot, ns);
+            }
+            benchKeep(output[0]);
+        }, totalFrames, gRepeats);
+        double worstBlockNs = *std::max_element(blockNs.begin(), blockNs.end());
+        double meanBlockNs = 0;
+        for (double ns : blockNs)
+            meanBlockNs += ns / blockNs.size();
+
+        // the work of the tail is spread over the blocks of its period
+        if (worstBlockNs > 1.3 * meanBlockNs) {
+            fprintf(stderr, "FAIL %s: the worst block took %.2f times the mean\n", name, worstBlockNs / meanBlockNs);
+            ++gFailures;
+        }
+
+        // the whole engine at 4x, with and without the cabinet
+        std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+        dsp->setSampleRate(kSampleRate);
+        setDefaultParameters(*dsp);
+        dsp->setParameterValue(pIdOversampling, 4);
+        auto runAll = [&]() {
+            for (uint32_t i = 0; i < totalFrames; i += blockSize)
+                dsp->run(&input[i], &output[i], blockSize);
+            benchKeep(output[0]);
+        };
+        BenchMeasure without = benchMeasure(runAll, totalFrames, gRepeats);
+        dsp->setImpulseResponse(response.data(), taps, kSampleRate);
+        dsp->waitForWorker();
+        BenchMeasure with = benchMeasure(runAll, totalFrames, gRepeats);
+
+        json.beginResult();
+        json.field("name", "cabinet");
+        json.field("length_s", length);
+        json.field("taps", (long)taps);
+        json.field("partition", (long)convolver->getPartitionSize());
+        json.field("block_size", (long)blockSize);
+        writeMeasure(json, m);
+        json.field("worst_block_ns", worstBlockNs);
+        json.field("mean_block_ns", meanBlockNs);
+        json.field("deadline_ns", 1e9 * blockSize / kSampleRate);
+        json.field("max_error", maxError);
+        json.field("run_4x_ns_per_sample", without.nsPerSample);
+        json.field("run_4x_cabinet_ns_per_sample", with.nsPerSample);
+        json.endResult();
+    }
+}
+
+/**
+ * The pipelined mode against the plain one, at the heavy ratios and small
+ * blocks where it is meant to help. The speedup needs a second core for the
+ * helper; with a single one, the audio thread takes most of the jobs.
+ */
+static void benchPipeline(BenchJsonWriter &json)
+{
+    static const unsigned ratios[] = {8, 16};
+    static const uint32_t blockSizes[] = {32, 64, 128};
+    constexpr uint32_t totalFrames = 16384;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), totalFrames, kSampleRate);
+
+    for (unsigned ratio : ratios) {
+        for (uint32_t blockSize : blockSizes) {
+            for (unsigned pipelined = 0; pipelined < 2; ++pipelined) {
+                char name[64];
+                sprintf(name, "pipeline/%ux/%u/%s", ratio, blockSize, pipelined ? "on" : "off");
+                if (!benchSelected(name))
+                    continue;
+
+                std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+                dsp->setSampleRate(kSampleRate);
+                dsp->setBlockSize(blockSize);
+                setDefaultParameters(*dsp);
+                dsp->setParameterValue(pIdOversampling, ratio);
+                dsp->setPipelined(pipelined);
+                dsp->waitForWorker();
+                // adopts the memory of the pipeline
+                dsp->run(&input[0], &output[0], blockSize);
+                unsigned takenBefore = dsp->getPipelineTakenJobs();
+
+                // the time of each block is its fastest over the runs, as
+                // for the cabinet, and the jitter is their deviation
+                std::vector<double> blockNs(totalFrames / blockSize, HUGE_VAL);
+                BenchMeasure m = benchMeasure([&]() {
+                    for (uint32_t i = 0; i < totalFrames; i += blockSize) {
+                        uint64_t t0 = benchReadNanoseconds();
+                        dsp->run(&input[i], &output[i], blockSize);
+                        double ns = benchReadNanoseconds() - t0;
+                        blockNs[i / blockSize] = std::min(blockNs[i / blockSize], ns);
+                    }
+                    benchKeep(output[0]);
+                }, totalFrames, gRepeats);
+                double worstBlockNs = *std::max_element(blockNs.begin(), blockNs.end());
+                double meanBlockNs = 0, jitterNs = 0;
+                for (double ns : blockNs)
+                    meanBlockNs += ns / blockNs.size();
+                for (double ns : blockNs)
+                    jitterNs += (ns - meanBlockNs) * (ns - meanBlockNs) / blockNs.size();
+                jitterNs = std::sqrt(jitterNs);
+
+                // the share of the jobs of the helper which the audio thread
+                // ran itself, one per chunk, over the warm-up and the runs
+                uint32_t chunkSize = dsp->getChunkSize() ? std::min(blockSize, dsp->getChunkSize()) : blockSize;
+                double jobs = (double)(gRepeats + 1) * totalFrames / chunkSize;
+                double taken = dsp->getPipelineTakenJobs() - takenBefore;
+
+                json.beginResult();
+                json.field("name", "pipeline");
+                json.field("ratio", (long)ratio);
+                json.field("block_size", (long)blockSize);
+                json.field("pipelined", (long)pipelined);
+                json.field("latency", (long)dsp->getLatency());
+                writeMeasure(json, m);
+                json.field("worst_block_ns", worstBlockNs);
+                json.field("mean_block_ns", meanBlockNs);
+                json.field("jitter_ns", jitterNs);
+                json.field("deadline_ns", 1e9 * blockSize / kSampleRate);
+                json.field("taken_jobs", pipelined ? taken / jobs : 0.0);
+                json.endResult();
+            }
+        }
+    }
+}
+
+static void benchTelemetry(BenchJsonWriter &json)
+{
+    constexpr uint32_t blockSize = 64;
+    constexpr uint32_t totalFrames = 16384;
+
+    std::vector<float> input(totalFrames), output(totalFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), totalFrames, kSampleRate);
+
+    for (const auto &ov : OversamplingValues) {
+        if (!isOversamplingRatio(ov.first))
+            continue;
+        char name[64];
+        sprintf(name, "telemetry/%ux", ov.first);
+        if (!benchSelected(name))
+            continue;
+
+        std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+        dsp->setSampleRate(kSampleRate);
+        setDefaultParameters(*dsp);
+        dsp->setParameterValue(pIdOversampling, ov.first);
+
+        auto runAll = [&]() {
+            TelemetryRecord rec;
+            for (uint32_t i = 0; i < totalFrames; i += blockSize) {
+                dsp->run(&input[i], &output[i], blockSize);
+                while (dsp->getTelemetry().read(rec));
+            }
+            benchKeep(output[0]);
+        };
+
+        // once calibrated, the cycle counter is calibrated again every 256
+        // blocks, with or without the timing of the stages
+        dsp->getTelemetry().setStageTiming(false);
+        do
+            runAll();
+        while (QUADRAFUZZ_TELEMETRY && dsp->getTelemetry().getBlockLoad() == 0);
+        uint32_t calibrations = dsp->getTelemetry().getCalibrationCount();
+        BenchMeasure off = benchMeasure(runAll, totalFrames, gRepeats);
+        calibrations = dsp->getTelemetry().getCalibrationCount() - calibrations;
+        double blocksPerCalibration = calibrations ? (double)(gRepeats + 1) * (totalFrames / blockSize) / calibrations : 0;
+        if (QUADRAFUZZ_TELEMETRY && std::fabs(blocksPerCalibration - 256) > 1) {
+            fprintf(stderr, "FAIL %s: calibrated every %g blocks instead of 256\n", name, blocksPerCalibration);
+            ++gFailures;
+        }
+        dsp->getTelemetry().setStageTiming(true);
+        BenchMeasure on = benchMeasure(runAll, totalFrames, gRepeats);
+
+        json.beginResult();
+        json.field("name", "telemetry_stages");
+        json.field("ratio", (long)ov.first);
+        json.field("block_size", (long)blockSize);
+        writeMeasure(json, on);
+        json.field("overhead_percent", 100 * (on.nsPerSample / off.nsPerSample - 1));
+        json.field("blocks_per_calibration", blocksPerCalibration);
+        json.endResult();
+    }
+}
+
+///
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: quadrafuzz-bench [-o output.json] [-r repeats] [-f filter]\n"
+            "  -o  write the JSON results to a file instead of stdout\n"
+            "  -r  number of timed runs per case, the median is kept\n"
+            "  -f  only run the cases whose name contains this string\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outputPath = nullptr;
+
+    for (int c; (c = getopt(argc, argv, "o:r:f:h")) != -1;) {
+        switch (c) {
+        case 'o':
+            outputPath = optarg;
+            break;
+        case 'r':
+            gRepeats = std::max(1, atoi(optarg));
+            break;
+        case 'f':
+            gFilter = optarg;
+            break;
+        default:
+            usage();
+            return (c == 'h') ? 0 : 1;
+        }
+    }
+
+    FILE *stream = stdout;
+    if (outputPath && !(stream = fopen(outputPath, "w"))) {
+        perror(outputPath);
+        return 1;
+    }
+
+    benchResetFloatingPointMode();
+
+    BenchJsonWriter json(stream);
+    json.begin("quadrafuzz-bench");
+    json.beginResult();
+    json.field("name", "config");
+    json.field("telemetry", (long)QUADRAFUZZ_TELEMETRY);
+    json.field("isa", selectKernels().name);
+    json.endResult();
+    benchOversampler<2, 32>(json);
+    benchOversampler<4, 64>(json);
+    benchOversampler<8, 64>(json);
+    benchBiquad(json);
+    benchDistort(json);
+    benchKernels(json);
+    benchRun(json);
+    benchAuto(json);
+    benchBudget(json);
+    benchRate(json);
+    benchChunk(json);
+    benchBands(json);
+    benchMute(json);
+    benchRamp(json);
+    benchSwitch(json);
+    benchCabinet(json);
+    benchPipeline(json);
+    benchTelemetry(json);
+    json.end();
+
+    if (stream != stdout)
+        fclose(stream);
+
+    if (gFailures) {
+        fprintf(stderr, "%u benchmark checks failed\n", gFailures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,327 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "BenchCommon.hpp"
+#include "QuadrafuzzDSP.hpp"
+#include <memory>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+static unsigned gRepeats = 15;
+static constexpr double kSampleRate = 44100;
+
+/* the longest kernel which the search tries */
+static constexpr unsigned kMaxTaps = QuadrafuzzKernels::FirState::MaxTaps;
+
+/* a kernel of an oversampler, its response and its cost */
+struct Design {
+    const char *name;
+    unsigned ratio;
+    unsigned taps;
+    std::vector<float> kernel;
+    QuadrafuzzFilterResponse response;
+    /* interpolation and decimation, per input sample */
+    BenchMeasure cost;
+    /* whether the engine oversamples with this kernel */
+    bool engine;
+};
+
+template <class Oversampler>
+static Design measureDesign(const char *name, uint32_t taps, bool engine)
+{
+    constexpr uint32_t frames = 4096;
+    constexpr uint32_t Over = Oversampler::Ratio;
+
+    std::unique_ptr<Oversampler> os(new Oversampler);
+
+    Design d;
+    d.name = name;
+    d.ratio = Over;
+    d.taps = taps;
+    d.engine = engine;
+    d.kernel.assign(os->fir.down.c, os->fir.down.c + taps);
+    d.response = measureFilter(OversamplerSpec, Over, d.kernel.data(), taps);
+
+    std::vector<float> input(frames), over(Over * frames), output(frames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), frames, kSampleRate);
+
+    const QuadrafuzzKernels &k = selectKernels();
+    const QuadrafuzzKernels::FirState up{os->fir.up.c, os->fir.up.x, taps, os->fir.up.m, &os->fir.up.h};
+    const QuadrafuzzKernels::FirState down{os->fir.down.c, os->fir.down.x, taps, os->fir.down.m, &os->fir.down.h};
+    d.cost = benchMeasure([&]() {
+        k.upsample(up, Over, input.data(), over.data(), frames);
+        k.downsample(down, Over, over.data(), output.data(), frames);
+        benchKeep(output[0]);
+    }, frames, gRepeats);
+
+    return d;
+}
+
+/* instantiations of the engine, the first with an empty cache of kernels,
+   and a second reader of the cache, as another process would be */
+struct CacheCheck {
+    double coldMs, warmMs;
+    unsigned designed, redesigned;
+    bool identical;
+};
+
+static constexpr unsigned kInstances = 16;
+
+static CacheCheck checkCache()
+{
+    CacheCheck check;
+    QuadrafuzzKernelCache &cache = QuadrafuzzKernelCache::get();
+
+    // the tables which the instances share besides the kernels
+    QuadrafuzzAliasModel::get();
+    selectKernels();
+
+    std::vector<std::unique_ptr<QuadrafuzzDSP>> instances;
+    uint64_t t0 = benchReadNanoseconds();
+    instances.emplace_back(new QuadrafuzzDSP);
+    uint64_t t1 = benchReadNanoseconds();
+    for (unsigned i = 1; i < kInstances; ++i)
+        instances.emplace_back(new QuadrafuzzDSP);
+    uint64_t t2 = benchReadNanoseconds();
+    check.coldMs = 1e-6 * (t1 - t0);
+    check.warmMs = 1e-6 * (t2 - t1) / (kInstances - 1);
+    check.designed = cache.designCount();
+
+    // the reader must find every kernel, as the designer gives it; the
+    // oversamplers which keep the windowed sinc have none
+    QuadrafuzzKernelCache reader(cache.path());
+    const unsigned kernels[][3] = {
+        {2, QuadrafuzzDSP::Oversampler2x::KernelTaps, QuadrafuzzDSP::Oversampler2x::IsEquiripple},
+        {4, QuadrafuzzDSP::Oversampler4x::KernelTaps, QuadrafuzzDSP::Oversampler4x::IsEquiripple},
+        {8, QuadrafuzzDSP::Oversampler8x::KernelTaps, QuadrafuzzDSP::Oversampler8x::IsEquiripple},
+        {16, QuadrafuzzDSP::Oversampler16x::KernelTaps, QuadrafuzzDSP::Oversampler16x::IsEquiripple},
+    };
+    check.identical = true;
+    for (const auto &k : kernels) {
+        if (!k[2])
+            continue;
+        float cached[kMaxTaps], designed[kMaxTaps];
+        check.identical = check.identical &&
+            reader.equiripple(OversamplerSpec, k[0], k[1], cached) &&
+            designEquiripple(OversamplerSpec, k[0], k[1], designed) >= 0 &&
+            memcmp(cached, designed, k[1] * sizeof(float)) == 0;
+    }
+    check.redesigned = reader.designCount();
+
+    return check;
+}
+
+static void writeDesign(BenchJsonWriter &json, const Design &d)
+{
+    json.beginResult();
+    json.field("name", d.name);
+    json.field("ratio", (long)d.ratio);
+    json.field("taps", (long)d.taps);
+    json.field("ripple_db", d.response.ripple);
+    json.field("stop_db", d.response.stopAttenuation);
+    json.field("alias_db", d.response.aliasAttenuation);
+    json.field("meets", (long)d.response.meets(OversamplerSpec));
+    json.field("engine", (long)d.engine);
+    json.field("ns_per_sample", d.cost.nsPerSample);
+    json.field("cycles_per_sample", d.cost.cyclesPerSample);
+    json.endResult();
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: quadrafuzz-design [-o output.json] [-t table.txt] [-r repeats]\n"
+            "  -o  write the JSON results to a file instead of stdout\n"
+            "  -t  write the side-by-side responses to a file\n"
+            "  -r  number of timed runs per case, the median is kept\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outputPath = nullptr;
+    const char *tablePath = nullptr;
+
+    for (int c; (c = getopt(argc, argv, "o:t:r:h")) != -1;) {
+        switch (c) {
+        case 'o':
+            outputPath = optarg;
+            break;
+        case 't':
+            tablePath = optarg;
+            break;
+        case 'r':
+            gRepeats = std::max(1, atoi(optarg));
+            break;
+        default:
+            usage();
+            return (c == 'h') ? 0 : 1;
+        }
+    }
+
+    FILE *stream = stdout;
+    if (outputPath && !(stream = fopen(outputPath, "w"))) {
+        perror(outputPath);
+        return 1;
+    }
+
+    // an empty cache of kernels, which leaves the one of the user alone
+    char cacheDir[] = "/tmp/quadrafuzz-design-XXXXXX";
+    if (!mkdtemp(cacheDir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    const std::string cachePath = std::string(cacheDir) + "/kernels.bin";
+    setenv("QUADRAFUZZ_KERNEL_CACHE", cachePath.c_str(), 1);
+
+    benchResetFloatingPointMode();
+
+    const CacheCheck cacheCheck = checkCache();
+
+    // the windowed sincs of the caps library, and the shortest equiripple
+    // kernels which meet the spec; the engine keeps the sinc at 2x and 8x,
+    // where the equiripple kernel is no cheaper
+    typedef QuadrafuzzDSP Engine;
+    typedef EquirippleOversampler<2, 32, 18> Equiripple2x;
+    typedef Engine::Oversampler4x Equiripple4x;
+    typedef EquirippleOversampler<8, 64, 64> Equiripple8x;
+    typedef Engine::Oversampler16x Equiripple16x;
+    const Design designs[][2] = {
+        {measureDesign<DSP::Oversampler<2, 32>>("window", 32, !Engine::Oversampler2x::IsEquiripple),
+         measureDesign<Equiripple2x>("equiripple", Equiripple2x::KernelTaps, Engine::Oversampler2x::IsEquiripple)},
+        {measureDesign<DSP::Oversampler<4, 64>>("window", 64, !Engine::Oversampler4x::IsEquiripple),
+         measureDesign<Equiripple4x>("equiripple", Equiripple4x::KernelTaps, Engine::Oversampler4x::IsEquiripple)},
+        {measureDesign<DSP::Oversampler<8, 64>>("window", 64, !Engine::Oversampler8x::IsEquiripple),
+         measureDesign<Equiripple8x>("equiripple", Equiripple8x::KernelTaps, Engine::Oversampler8x::IsEquiripple)},
+        {measureDesign<DSP::Oversampler<16, 256>>("window", 256, !Engine::Oversampler16x::IsEquiripple),
+         measureDesign<Equiripple16x>("equiripple", Equiripple16x::KernelTaps, Engine::Oversampler16x::IsEquiripple)},
+    };
+
+    BenchJsonWriter json(stream);
+    json.begin("quadrafuzz-design");
+    json.beginResult();
+    json.field("name", "spec");
+    json.field("passband", OversamplerSpec.passband);
+    json.field("stopband", OversamplerSpec.stopband);
+    json.field("aliasband", OversamplerSpec.aliasband);
+    json.field("ripple_db", OversamplerSpec.ripple);
+    json.field("stop_db", OversamplerSpec.stopAttenuation);
+    json.field("alias_db", OversamplerSpec.aliasAttenuation);
+    json.endResult();
+
+    json.beginResult();
+    json.field("name", "cache");
+    json.field("instances", (long)kInstances);
+    json.field("cold_ms", cacheCheck.coldMs);
+    json.field("warm_ms", cacheCheck.warmMs);
+    json.field("designed", (long)cacheCheck.designed);
+    json.field("redesigned", (long)cacheCheck.redesigned);
+    json.field("identical", (long)cacheCheck.identical);
+    json.endResult();
+
+    unsigned failures = 0;
+    if (cacheCheck.redesigned != 0 || !cacheCheck.identical) {
+        fprintf(stderr, "FAIL the cache of kernels does not give back the designs\n");
+        ++failures;
+    }
+
+    for (const auto &pair : designs) {
+        const Design &eq = pair[1];
+        writeDesign(json, pair[0]);
+        writeDesign(json, eq);
+
+        // the engine must use the shortest kernel which meets the spec
+        uint64_t t0 = benchReadNanoseconds();
+        unsigned shortest = findEquirippleTaps(OversamplerSpec, eq.ratio, kMaxTaps);
+        uint64_t t1 = benchReadNanoseconds();
+        json.beginResult();
+        json.field("name", "search");
+        json.field("ratio", (long)eq.ratio);
+        json.field("shortest_taps", (long)shortest);
+        json.field("search_ms", 1e-6 * (t1 - t0));
+        json.endResult();
+
+        if (!eq.response.meets(OversamplerSpec)) {
+            fprintf(stderr, "FAIL %ux: the equiripple kernel misses the spec\n", eq.ratio);
+            ++failures;
+        }
+        else if (shortest != eq.taps) {
+            fprintf(stderr, "FAIL %ux: the shortest kernel which meets the spec has %u taps, not %u\n",
+                    eq.ratio, shortest, eq.taps);
+            ++failures;
+        }
+    }
+    json.end();
+
+    if (stream != stdout)
+        fclose(stream);
+
+    unlink(cachePath.c_str());
+    unlink((cachePath + ".lock").c_str());
+    rmdir(cacheDir);
+
+    FILE *table = tablePath ? fopen(tablePath, "w") : stderr;
+    if (!table) {
+        perror(tablePath);
+        return 1;
+    }
+    fprintf(table, "%-6s %-11s %5s %10s %10s %10s %12s %7s\n",
+            "ratio", "design", "taps", "ripple", "stopband", "aliasband", "cpu ns/smp", "engine");
+    for (const auto &pair : designs) {
+        for (const Design &d : pair) {
+            fprintf(table, "%-6u %-11s %5u %7.2f dB %7.1f dB %7.1f dB %12.2f %7s\n",
+                    d.ratio, d.name, d.taps, d.response.ripple, -d.response.stopAttenuation,
+                    -d.response.aliasAttenuation, d.cost.nsPerSample, d.engine ? "*" : "");
+        }
+    }
+    fprintf(table, "\ninstantiation: %.2f ms with an empty cache, %.2f ms with the kernels in the cache\n",
+            cacheCheck.coldMs, cacheCheck.warmMs);
+    fprintf(table, "\ngain in dB, at fractions of the host rate, of the window | equiripple kernels\n%-6s", "freq");
+    for (const auto &pair : designs)
+        fprintf(table, " %15ux", pair[0].ratio);
+    fprintf(table, "\n");
+    for (unsigned i = 0; i <= 40; ++i) {
+        double f = i / 40.0;
+        fprintf(table, "%-6.3f", f);
+        for (const auto &pair : designs) {
+            if (f > 0.5 * pair[0].ratio) {
+                fprintf(table, " %16s", "");
+                continue;
+            }
+            fprintf(table, " %7.1f | %6.1f",
+                    filterGain(pair[0].ratio, pair[0].kernel.data(), pair[0].taps, f),
+                    filterGain(pair[1].ratio, pair[1].kernel.data(), pair[1].taps, f));
+        }
+        fprintf(table, "\n");
+    }
+    if (table != stderr)
+        fclose(table);
+
+    if (failures) {
+        fprintf(stderr, "%u kernels failed the check of the design\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
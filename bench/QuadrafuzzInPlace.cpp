@@ -0,0 +1,190 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "BenchCommon.hpp"
+#include "QuadrafuzzDSP.hpp"
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+static constexpr double kSampleRate = 44100;
+static constexpr uint32_t kTotalFrames = 32768;
+
+enum Program {
+    kProgramStatic,
+    kProgramAutomation,
+    kProgramOversampling,
+    kProgramBypass,
+    kProgramCount,
+};
+
+static const char *const programNames[kProgramCount] = {
+    "static", "automation", "oversampling", "bypass",
+};
+
+/**
+ * Apply the parameter changes of a program, before the block at `frame`.
+ */
+static void applyProgram(QuadrafuzzDSP &dsp, Program program, int oversampling, uint32_t frame, uint32_t block)
+{
+    static const unsigned ratios[] = {1, 2, 4, 8};
+    // a change every 1/20 s, at the first block which crosses it
+    constexpr uint32_t interval = 2205;
+    uint32_t k = frame / interval;
+    bool change = (frame == 0) || (frame % interval) + block > interval || block >= interval;
+
+    if (frame == 0) {
+        dsp.setParameterValue(pIdOversampling, oversampling);
+        dsp.setParameterValue(pIdDryGain, -6);
+    }
+    if (!change)
+        return;
+
+    switch (program) {
+    default:
+    case kProgramStatic:
+        break;
+    case kProgramAutomation:
+        dsp.setParameterValue(pIdInputGain, (k % 3) * 4.0f - 4);
+        dsp.setParameterValue(pIdOutputGain, (k % 5) * -3.0f);
+        dsp.setParameterValue(pIdDryGain, (k % 4) * -10.0f);
+        dsp.setParameterValue(pIdWetGain, (k % 2) * -6.0f);
+        dsp.setParameterValue(pIdDrive, (k % 5) / 4.0f);
+        dsp.setParameterValue(pIdDrive + QuadrafuzzDSP::Bands - 1, (k % 3) / 2.0f);
+        dsp.setParameterValue(pIdMute + 1, k % 4 == 1);
+        dsp.setParameterValue(pIdSolo, k % 7 == 3);
+        break;
+    case kProgramOversampling:
+        dsp.setParameterValue(pIdOversampling, ratios[k % 4]);
+        break;
+    case kProgramBypass:
+        dsp.setParameterValue(pIdBypass, k & 1);
+        break;
+    }
+}
+
+/**
+ * Render the program, either with distinct buffers or in place, and
+ * return the output.
+ */
+static std::vector<float> render(const std::vector<float> &input, Program program, int oversampling, uint32_t block, bool pipelined, bool inPlace)
+{
+    std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+    dsp->setSampleRate(kSampleRate);
+    dsp->setBlockSize(block);
+    dsp->setPipelined(pipelined);
+    dsp->waitForWorker();
+
+    std::vector<float> output(kTotalFrames);
+    std::vector<float> buffer(inPlace ? kTotalFrames : 0);
+    if (inPlace)
+        buffer = input;
+
+    for (uint32_t i = 0; i < kTotalFrames; i += block) {
+        uint32_t frames = std::min(block, kTotalFrames - i);
+        applyProgram(*dsp, program, oversampling, i, frames);
+        if (inPlace)
+            dsp->run(&buffer[i], &buffer[i], frames);
+        else
+            dsp->run(&input[i], &output[i], frames);
+    }
+
+    if (inPlace)
+        output = buffer;
+    return output;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: quadrafuzz-inplace [-v]\n"
+            "  -v  print the passing cases too\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose = false;
+
+    for (int c; (c = getopt(argc, argv, "vh")) != -1;) {
+        switch (c) {
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage();
+            return (c == 'h') ? 0 : 1;
+        }
+    }
+
+    benchResetFloatingPointMode();
+
+    std::vector<float> input(kTotalFrames);
+    benchGenerateSignal(kBenchSignalNormal, input.data(), kTotalFrames, kSampleRate);
+
+    static const uint32_t blockSizes[] = {1, 63, 64, 100, 4096};
+    unsigned failures = 0;
+    unsigned cases = 0;
+
+    for (const auto &ov : OversamplingValues) {
+        for (unsigned program = 0; program < kProgramCount; ++program) {
+            for (uint32_t block : blockSizes) {
+                for (unsigned pipelined = 0; pipelined < 2; ++pipelined) {
+                    std::vector<float> separate = render(input, (Program)program, ov.first, block, pipelined, false);
+                    std::vector<float> inPlace = render(input, (Program)program, ov.first, block, pipelined, true);
+
+                    // the same computations must give the same bits
+                    uint32_t mismatches = 0;
+                    float maxDiff = 0;
+                    for (uint32_t i = 0; i < kTotalFrames; ++i) {
+                        if (memcmp(&separate[i], &inPlace[i], sizeof(float)) != 0) {
+                            ++mismatches;
+                            maxDiff = std::max(maxDiff, std::fabs(separate[i] - inPlace[i]));
+                        }
+                    }
+
+                    ++cases;
+                    if (mismatches > 0) {
+                        ++failures;
+                        fprintf(stderr, "FAIL %s, %s, block %u%s: %u frames differ, by up to %g\n",
+                                ov.second, programNames[program], block, pipelined ? ", pipelined" : "", mismatches, maxDiff);
+                    }
+                    else if (verbose)
+                        fprintf(stderr, "PASS %s, %s, block %u%s\n", ov.second, programNames[program], block, pipelined ? ", pipelined" : "");
+                }
+            }
+        }
+    }
+
+    if (failures) {
+        fprintf(stderr, "%u of %u cases differ when processing in place\n", failures, cases);
+        return 1;
+    }
+
+    fprintf(stderr, "%u cases are identical in place\n", cases);
+    return 0;
+}
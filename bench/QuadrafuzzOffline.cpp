@@ -0,0 +1,203 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "BenchCommon.hpp"
+#include "QuadrafuzzDSP.hpp"
+#include "QuadrafuzzFreewheel.hpp"
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
+
+static constexpr double kSampleRate = 48000;
+static constexpr uint32_t kBlockSize = 256;
+
+static unsigned gFailures = 0;
+
+static void check(bool pass, const char *scenario)
+{
+    fprintf(stderr, "%s %s\n", pass ? "PASS" : "FAIL", scenario);
+    gFailures += !pass;
+}
+
+/**
+ * A host which drives the engine like the plugin does, either at the pace
+ * of the audio, or as fast as it can. Without detection, it stays in real
+ * time whatever the pace, for reference.
+ */
+class StandInHost
+{
+public:
+    explicit StandInHost(bool detect)
+        : fDSP(new QuadrafuzzDSP),
+          fDetect(detect),
+          fInput(kSampleRate),
+          fOutput(kBlockSize)
+    {
+        fDSP->setSampleRate(kSampleRate);
+        fDSP->setBlockSize(kBlockSize);
+        fDSP->waitForWorker();
+        benchGenerateSignal(kBenchSignalNormal, fInput.data(), fInput.size(), kSampleRate);
+    }
+
+    QuadrafuzzDSP &getDSP() { return *fDSP; }
+
+    struct Result {
+        /* the audio until the first block with a change of the detection,
+           in seconds, or a negative number without change */
+        double change = -1;
+        bool offline = false;
+        unsigned oversampling = 0;
+    };
+
+    Result play(double seconds, bool realtime)
+    {
+        typedef std::chrono::steady_clock Clock;
+        const auto blockDuration = std::chrono::duration<double>(kBlockSize / kSampleRate);
+        Clock::time_point deadline = Clock::now();
+        bool wasOffline = fDSP->isOffline();
+
+        Result result;
+        uint32_t blocks = (uint32_t)(seconds * kSampleRate / kBlockSize);
+        for (uint32_t b = 0; b < blocks; ++b) {
+            if (realtime) {
+                deadline += std::chrono::duration_cast<Clock::duration>(blockDuration);
+                std::this_thread::sleep_until(deadline);
+            }
+
+            // what the plugin does in its `run`
+            if (fDetect)
+                fDSP->setOffline(fFreewheel.process(kBlockSize, kSampleRate));
+            fDSP->run(&fInput[fPosition], fOutput.data(), kBlockSize);
+            fPosition = (fPosition + kBlockSize) % (fInput.size() - kBlockSize);
+
+            if (result.change < 0 && fDSP->isOffline() != wasOffline)
+                result.change = b * kBlockSize / kSampleRate;
+        }
+
+        result.offline = fDSP->isOffline();
+        result.oversampling = fDSP->getParameterValue(pIdEffectiveOversampling);
+        return result;
+    }
+
+private:
+    std::unique_ptr<QuadrafuzzDSP> fDSP;
+    bool fDetect = true;
+    QuadrafuzzFreewheel fFreewheel;
+    std::vector<float> fInput;
+    std::vector<float> fOutput;
+    uint32_t fPosition = 0;
+};
+
+/* the values of the parameters which are not outputs */
+static std::vector<float> inputParameters(const QuadrafuzzDSP &dsp)
+{
+    std::vector<float> values;
+    for (uint32_t index = 0; index < Parameter_Count; ++index) {
+        bool output = index == pIdDspLoad || index == pIdDspLoadPeak ||
+            index == pIdEffectiveOversampling ||
+            (index >= pIdActivity && index < pIdActivity + QuadrafuzzDSP::Bands);
+        if (!output)
+            values.push_back(dsp.getParameterValue(index));
+    }
+    return values;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: quadrafuzz-offline\n");
+}
+
+int main(int argc, char *argv[])
+{
+    for (int c; (c = getopt(argc, argv, "h")) != -1;) {
+        usage();
+        return (c == 'h') ? 0 : 1;
+    }
+
+    benchResetFloatingPointMode();
+
+    static const int settings[] = {2, OversamplingAuto};
+    char scenario[256];
+
+    for (int oversampling : settings) {
+        const char *name = "";
+        for (const auto &ov : OversamplingValues)
+            name = (ov.first == oversampling) ? ov.second : name;
+
+        StandInHost host(true), reference(false);
+        for (StandInHost *h : {&host, &reference}) {
+            QuadrafuzzDSP &dsp = h->getDSP();
+            dsp.setParameterValue(pIdDryGain, -40);
+            for (unsigned b = 0; b < QuadrafuzzDSP::Bands; ++b)
+                dsp.setParameterValue(pIdDrive + b, QuadrafuzzDSP::getBand(b).drive);
+            dsp.setParameterValue(pIdOversampling, oversampling);
+        }
+        QuadrafuzzDSP &dsp = host.getDSP();
+        const std::vector<float> parameters = inputParameters(dsp);
+
+        // the prefetching of a host runs ahead of time, by its buffer
+        StandInHost::Result prefetch = host.play(0.75, false);
+        StandInHost::Result realtime = host.play(1.5, true);
+        sprintf(scenario, "%s, real time with prefetching stays real time, at %ux", name, realtime.oversampling);
+        check(prefetch.change < 0 && realtime.change < 0 && !realtime.offline, scenario);
+
+        // four windows in a row of 500 ms of audio
+        StandInHost::Result offline = host.play(4, false);
+        sprintf(scenario, "%s, offline after %.2f s of audio, at %ux", name, offline.change, offline.oversampling);
+        check(offline.offline && offline.change >= 0 && offline.change < 2.5 &&
+              offline.oversampling == (unsigned)OversamplingOffline, scenario);
+
+        // back in real time within two windows of the detection, at the
+        // oversampling of a host which never rendered offline
+        StandInHost::Result back = host.play(1.5, true);
+        StandInHost::Result never = reference.play(0.75 + 1.5 + 4 + 1.5, false);
+        sprintf(scenario, "%s, real time after %.3f s of audio, at %ux", name, back.change, back.oversampling);
+        check(!back.offline && back.change >= 0 && back.change < 0.15 &&
+              back.oversampling == never.oversampling, scenario);
+
+        sprintf(scenario, "%s, parameters unchanged", name);
+        check(inputParameters(dsp) == parameters, scenario);
+    }
+
+    // a budget which the offline ratio does not fit keeps a lighter one, as
+    // the host could be in real time after all
+    {
+        StandInHost host(true);
+        QuadrafuzzDSP &dsp = host.getDSP();
+        dsp.setParameterValue(pIdOversampling, 2);
+        dsp.setParameterValue(pIdCpuBudget, 0.5f);
+        StandInHost::Result offline = host.play(6, false);
+        sprintf(scenario, "offline under a budget of 0.5%%, at %ux", offline.oversampling);
+        check(offline.offline && offline.oversampling < (unsigned)OversamplingOffline, scenario);
+    }
+
+    if (gFailures) {
+        fprintf(stderr, "%u scenarios failed\n", gFailures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,316 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "BenchCommon.hpp"
+#include "RtCheck.h"
+#include "QuadrafuzzDSP.hpp"
+#include <memory>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <cerrno>
+
+static constexpr double kSampleRate = 44100;
+
+/**
+ * The part of the plugin interface which a host may call on the audio
+ * thread. In LV2, the control ports are also applied on the audio thread,
+ * so parameter changes are checked too.
+ */
+class Checker {
+public:
+    explicit Checker(QuadrafuzzDSP &dsp) : fDsp(dsp) {}
+
+    void setParameter(uint32_t index, float value)
+    {
+        enter();
+        fDsp.setParameterValue(index, value);
+        leave();
+    }
+
+    void run(uint32_t frames, uint32_t blocks = 1)
+    {
+        if (fInput.size() < frames) {
+            fInput.resize(frames);
+            fOutput.resize(frames);
+            benchGenerateSignal(kBenchSignalNormal, fInput.data(), frames, kSampleRate);
+        }
+        for (uint32_t i = 0; i < blocks; ++i) {
+            enter();
+            fDsp.run(fInput.data(), fOutput.data(), frames);
+            fDsp.getParameterValue(pIdDspLoad);
+            leave();
+        }
+    }
+
+private:
+    void enter()
+    {
+        getrusage(RUSAGE_THREAD, &fUsage);
+        rtcheck_begin();
+    }
+
+    void leave()
+    {
+        rtcheck_end();
+        rusage usage;
+        getrusage(RUSAGE_THREAD, &usage);
+        for (long i = fUsage.ru_minflt; i < usage.ru_minflt; ++i)
+            rtcheck_violation("minor page fault");
+        for (long i = fUsage.ru_majflt; i < usage.ru_majflt; ++i)
+            rtcheck_violation("major page fault");
+    }
+
+private:
+    QuadrafuzzDSP &fDsp;
+    std::vector<float> fInput;
+    std::vector<float> fOutput;
+    rusage fUsage;
+};
+
+static unsigned gFailures = 0;
+
+static void report(const char *scenario)
+{
+    const rtcheck_report *r = rtcheck_get_report();
+    if (r->count == 0) {
+        fprintf(stderr, "PASS %s\n", scenario);
+        return;
+    }
+
+    fprintf(stderr, "FAIL %s:", scenario);
+    for (unsigned i = 0; i < r->num_names; ++i)
+        fprintf(stderr, " %s (%u)", r->names[i], r->name_counts[i]);
+    fprintf(stderr, "\n");
+
+    ++gFailures;
+    rtcheck_reset();
+}
+
+/**
+ * Make the stack resident, like a host does when it locks its memory.
+ */
+static void __attribute__((noinline)) prefaultStack()
+{
+    volatile char stack[512 * 1024];
+    for (size_t i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+}
+
+/**
+ * Lock the memory which is mapped, like a real-time host does, so that the
+ * first run of a rare branch, in the plugin or in the math library, does
+ * not fault in its page of code. Later mappings are not locked, since that
+ * could make the allocations of the worker fail under the memlock limit.
+ */
+static void lockMemory()
+{
+    if (mlockall(MCL_CURRENT) != 0)
+        fprintf(stderr, "cannot lock the memory, the first runs of code may fault: %s\n", strerror(errno));
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: quadrafuzz-rtcheck [-a]\n"
+            "  -a  abort at the first violation, to get a backtrace in a debugger\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bool abortOnViolation = false;
+
+    for (int c; (c = getopt(argc, argv, "ah")) != -1;) {
+        switch (c) {
+        case 'a':
+            abortOnViolation = true;
+            break;
+        default:
+            usage();
+            return (c == 'h') ? 0 : 1;
+        }
+    }
+
+    rtcheck_init(abortOnViolation);
+    prefaultStack();
+
+    static const uint32_t blockSizes[] = {1, 64, 4096};
+    const uint32_t maxBlockSize = 4096;
+
+    // instantiation is not on the audio thread
+    std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+    dsp->setSampleRate(kSampleRate);
+    Checker checker(*dsp);
+
+    // warm up, all modes, the biggest block
+    for (const auto &ov : OversamplingValues) {
+        dsp->setParameterValue(pIdOversampling, ov.first);
+        checker.run(maxBlockSize);
+    }
+    lockMemory();
+    rtcheck_reset();
+
+    char scenario[256];
+
+    for (const auto &ov : OversamplingValues) {
+        checker.setParameter(pIdOversampling, ov.first);
+        for (uint32_t blockSize : blockSizes) {
+            checker.run(blockSize, 16);
+            sprintf(scenario, "run %s, block %u", ov.second, blockSize);
+            report(scenario);
+        }
+    }
+
+    for (const auto &from : OversamplingValues) {
+        for (const auto &to : OversamplingValues) {
+            checker.setParameter(pIdOversampling, from.first);
+            checker.run(64, 4);
+            checker.setParameter(pIdOversampling, to.first);
+            checker.run(64, 4);
+            sprintf(scenario, "oversampling %s to %s", from.second, to.second);
+            report(scenario);
+        }
+    }
+
+    // the worker allocates the memory of the new sizes, and frees the old
+    // one, while `run` goes on and then adopts the new memory
+    static const uint32_t chunkSizes[] = {0, 16, 64};
+    checker.setParameter(pIdOversampling, OversamplingValues.back().first);
+    for (uint32_t chunkSize : chunkSizes) {
+        for (uint32_t blockSize : blockSizes) {
+            dsp->setBlockSize(blockSize);
+            dsp->setChunkSize(chunkSize);
+            checker.run(64, 4);
+            dsp->waitForWorker();
+            checker.run(blockSize, 4);
+        }
+    }
+    dsp->setBlockSize(maxBlockSize);
+    dsp->setChunkSize(QUADRAFUZZ_CHUNK_FRAMES);
+    dsp->waitForWorker();
+    checker.run(64, 4);
+    report("block and chunk size changes");
+
+    // the worker reads the impulse responses and prepares the convolvers,
+    // which `run` crossfades into, and frees the ones which it replaced
+    {
+        char path[] = "/tmp/quadrafuzz-rtcheck-XXXXXX.wav";
+        int fd = mkstemps(path, 4);
+        if (fd != -1)
+            close(fd);
+        static const double lengths[] = {0.1, 2, 0.02};
+        for (double length : lengths) {
+            std::vector<float> response((uint32_t)(length * 48000));
+            benchGenerateSignal(kBenchSignalNormal, response.data(), response.size(), 48000);
+            if (fd == -1 || !benchWriteWav(path, response.data(), response.size(), 48000)) {
+                fprintf(stderr, "cannot write the impulse response %s\n", path);
+                ++gFailures;
+                break;
+            }
+            dsp->loadImpulseResponse(path);
+            checker.run(64, 4);
+            dsp->waitForWorker();
+            checker.run(64, 64);
+            checker.run(1, 64);
+        }
+        dsp->loadImpulseResponse("");
+        dsp->waitForWorker();
+        checker.run(64, 64);
+        if (fd != -1)
+            unlink(path);
+        report("cabinet changes");
+    }
+
+    // the worker starts the helper of the pipeline with the memory of its
+    // chunks, which `run` adopts, posts to, waits for, and takes jobs from
+    dsp->setPipelined(true);
+    checker.run(64, 4);
+    dsp->waitForWorker();
+    for (const auto &ov : OversamplingValues) {
+        checker.setParameter(pIdOversampling, ov.first);
+        for (uint32_t blockSize : blockSizes)
+            checker.run(blockSize, 4);
+        checker.setParameter(pIdBypass, 1);
+        checker.run(64, 4);
+        checker.setParameter(pIdBypass, 0);
+        checker.run(64, 4);
+    }
+    dsp->setPipelined(false);
+    checker.run(64, 4);
+    dsp->waitForWorker();
+    checker.run(64, 4);
+    report("pipeline");
+
+    // a tiny budget steps down to none, and a large one back up
+    checker.setParameter(pIdOversampling, OversamplingValues.back().first);
+    checker.setParameter(pIdCpuBudget, 0.01f);
+    checker.run(64, 1000);
+    checker.setParameter(pIdCpuBudget, 100);
+    checker.run(64, 8000);
+    checker.setParameter(pIdCpuBudget, 0);
+    checker.run(64, 4);
+    report("cpu budget");
+
+    static const struct { uint32_t index; float values[3]; } sweeps[] = {
+        {pIdBypass, {1, 0, 1}},
+        {pIdInputGain, {-40, 10, 0}},
+        {pIdOutputGain, {-40, 10, 0}},
+        {pIdDryGain, {-40, 10, -40}},
+        {pIdWetGain, {-40, 10, 0}},
+    };
+    static const float driveValues[] = {0, 1, 0.6};
+
+    for (const auto &ov : OversamplingValues) {
+        checker.setParameter(pIdOversampling, ov.first);
+        for (const auto &sweep : sweeps) {
+            for (float value : sweep.values) {
+                checker.setParameter(sweep.index, value);
+                checker.run(64, 4);
+            }
+        }
+        for (unsigned b = 0; b < QuadrafuzzDSP::Bands; ++b) {
+            for (float value : driveValues) {
+                checker.setParameter(pIdDrive + b, value);
+                checker.run(64, 4);
+            }
+            for (uint32_t index : {pIdMute + b, pIdSolo + b}) {
+                checker.setParameter(index, 1);
+                checker.run(64, 32);
+                checker.setParameter(index, 0);
+                checker.run(64, 4);
+            }
+        }
+        checker.setParameter(pIdBypass, 0);
+        sprintf(scenario, "parameter changes, %s", ov.second);
+        report(scenario);
+    }
+
+    if (gFailures) {
+        fprintf(stderr, "%u scenarios failed the real-time safety check\n", gFailures);
+        return 1;
+    }
+
+    return 0;
+}
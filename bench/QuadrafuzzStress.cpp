@@ -0,0 +1,386 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "BenchCommon.hpp"
+#include "QuadrafuzzDSP.hpp"
+#include <memory>
+#include <random>
+#include <limits>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+static constexpr double kSampleRate = 44100;
+
+enum SegmentKind {
+    kSegmentMusic,
+    kSegmentSilence,
+    kSegmentSquare,
+    kSegmentDC,
+    kSegmentDenormalTail,
+    kSegmentNonFinite,
+    kSegmentCount,
+};
+
+static const char *const segmentNames[] = {
+    "music", "silence", "square", "dc", "denormal_tail", "nonfinite",
+};
+
+/**
+ * Generator of an endless input, which jumps between normal and
+ * pathological signals every fraction of a second.
+ */
+class StressInput {
+public:
+    StressInput(std::mt19937 &rng, bool nonFinite)
+        : fRng(rng), fNonFinite(nonFinite)
+    {
+        nextSegment();
+    }
+
+    SegmentKind currentKind() const { return fKind; }
+
+    void generate(float *data, uint32_t frames)
+    {
+        for (uint32_t i = 0; i < frames; ++i) {
+            if (fRemaining-- == 0)
+                nextSegment();
+            data[i] = nextSample();
+        }
+    }
+
+private:
+    void nextSegment()
+    {
+        std::uniform_int_distribution<int> kindDist(0, kSegmentCount - (fNonFinite ? 1 : 2));
+        std::uniform_real_distribution<double> durationDist(0.1, 2.0);
+        std::uniform_real_distribution<double> unitDist(0.0, 1.0);
+
+        fKind = (SegmentKind)kindDist(fRng);
+        fRemaining = (uint32_t)(durationDist(fRng) * kSampleRate);
+        fPhase = 0;
+        fFrequency = 20 * std::pow(1000.0, unitDist(fRng));
+        fLevel = (unitDist(fRng) < 0.5) ? 1.0 : unitDist(fRng);
+        fLevel *= (unitDist(fRng) < 0.5) ? -1.0 : 1.0;
+        fDecay = 1.0;
+    }
+
+    float nextSample()
+    {
+        fPhase += fFrequency / kSampleRate;
+        fPhase -= (fPhase >= 1) ? 1 : 0;
+
+        switch (fKind) {
+        default:
+        case kSegmentMusic:
+            fDecay *= 0.99995;
+            return fLevel * fDecay * std::sin(2 * M_PI * fPhase) + 1e-3 * noise();
+        case kSegmentSilence:
+            return 0;
+        case kSegmentSquare:
+            return (fPhase < 0.5) ? 1.0f : -1.0f;
+        case kSegmentDC:
+            return fLevel;
+        case kSegmentDenormalTail:
+            // an exponential decay, which runs through the subnormal range
+            fDecay *= 0.999;
+            return fLevel * fDecay * ((fPhase < 0.5) ? 1 : -1);
+        case kSegmentNonFinite: {
+            std::uniform_int_distribution<int> pick(0, 99);
+            switch (pick(fRng)) {
+            case 0:
+                return std::numeric_limits<float>::quiet_NaN();
+            case 1:
+                return std::numeric_limits<float>::infinity();
+            case 2:
+                return -std::numeric_limits<float>::infinity();
+            default:
+                return fLevel * std::sin(2 * M_PI * fPhase);
+            }
+        }
+        }
+    }
+
+    float noise()
+    {
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        return dist(fRng);
+    }
+
+private:
+    std::mt19937 &fRng;
+    bool fNonFinite = true;
+    SegmentKind fKind = kSegmentMusic;
+    uint32_t fRemaining = 0;
+    double fPhase = 0;
+    double fFrequency = 0;
+    double fLevel = 0;
+    double fDecay = 0;
+};
+
+/**
+ * Random parameter change, in the range of the parameter.
+ * Returns the index of the parameter.
+ */
+static uint32_t randomParameterChange(QuadrafuzzDSP &dsp, std::mt19937 &rng)
+{
+    // every input parameter, the drives, mutes and solos included
+    std::uniform_int_distribution<uint32_t> indexDist(pIdBypass, pIdOversampling + 2 * QuadrafuzzDSP::Bands);
+    std::uniform_real_distribution<float> unitDist(0.0f, 1.0f);
+
+    uint32_t index = indexDist(rng);
+    if (index > pIdOversampling)
+        index = pIdMute + (index - pIdOversampling - 1);
+    float value;
+
+    if (index >= pIdMute) {
+        // mostly heard, muting would hide the processing
+        value = unitDist(rng) < 0.25f;
+        dsp.setParameterValue(index, value);
+        return index;
+    }
+
+    switch (index) {
+    case pIdBypass:
+        // rarely enabled, it would hide the processing
+        value = unitDist(rng) < 0.1f;
+        break;
+    case pIdInputGain:
+    case pIdOutputGain:
+    case pIdDryGain:
+    case pIdWetGain:
+        value = -40 + 50 * unitDist(rng);
+        break;
+    case pIdOversampling: {
+        std::uniform_int_distribution<size_t> dist(0, OversamplingValues.size() - 1);
+        value = OversamplingValues[dist(rng)].first;
+        break;
+    }
+    default:
+        value = unitDist(rng);
+        break;
+    }
+
+    dsp.setParameterValue(index, value);
+    return index;
+}
+
+struct BlockTiming {
+    uint64_t index;
+    uint32_t frames;
+    double seconds;
+    double deadlineShare;
+    int oversampling;
+    int changedParameter;
+    SegmentKind segment;
+};
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: quadrafuzz-stress [-o output.json] [-s seconds] [-b block] [-v] [-l share]\n"
+            "                         [-r seed] [-p changes] [-N] [-x]\n"
+            "  -o  write the JSON results to a file instead of stdout\n"
+            "  -s  duration of the session, in seconds of audio (default 60)\n"
+            "  -b  block size, in frames (default 128)\n"
+            "  -v  make the block sizes vary randomly, up to the block size\n"
+            "  -l  flag the blocks which take more than this share of their\n"
+            "      deadline (default 0.25)\n"
+            "  -r  seed of the random generator\n"
+            "  -p  probability of a parameter change per block (default 0.05)\n"
+            "  -N  do not send NaN and infinity in the input\n"
+            "  -x  exit with failure if any block was flagged\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outputPath = nullptr;
+    double sessionSeconds = 60;
+    uint32_t blockSize = 128;
+    bool variableBlocks = false;
+    double deadlineLimit = 0.25;
+    unsigned seed = 1;
+    double changeProbability = 0.05;
+    bool nonFinite = true;
+    bool strict = false;
+
+    for (int c; (c = getopt(argc, argv, "o:s:b:vl:r:p:Nxh")) != -1;) {
+        switch (c) {
+        case 'o':
+            outputPath = optarg;
+            break;
+        case 's':
+            sessionSeconds = atof(optarg);
+            break;
+        case 'b':
+            blockSize = std::max(1, atoi(optarg));
+            break;
+        case 'v':
+            variableBlocks = true;
+            break;
+        case 'l':
+            deadlineLimit = atof(optarg);
+            break;
+        case 'r':
+            seed = (unsigned)atoi(optarg);
+            break;
+        case 'p':
+            changeProbability = atof(optarg);
+            break;
+        case 'N':
+            nonFinite = false;
+            break;
+        case 'x':
+            strict = true;
+            break;
+        default:
+            usage();
+            return (c == 'h') ? 0 : 1;
+        }
+    }
+
+    FILE *stream = stdout;
+    if (outputPath && !(stream = fopen(outputPath, "w"))) {
+        perror(outputPath);
+        return 1;
+    }
+
+    benchResetFloatingPointMode();
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unitDist(0.0, 1.0);
+    std::uniform_int_distribution<uint32_t> blockDist(1, blockSize);
+
+    std::unique_ptr<QuadrafuzzDSP> dsp(new QuadrafuzzDSP);
+    dsp->setSampleRate(kSampleRate);
+    for (unsigned i = 0; i < 32; ++i)
+        randomParameterChange(*dsp, rng);
+    dsp->setParameterValue(pIdBypass, 0);
+
+    StressInput generator(rng, nonFinite);
+    std::vector<float> input(blockSize), output(blockSize);
+
+    const uint64_t totalFrames = (uint64_t)(sessionSeconds * kSampleRate);
+    std::vector<double> times;
+    times.reserve(totalFrames / (variableBlocks ? std::max(1u, blockSize / 2) : blockSize) + 1);
+    std::vector<BlockTiming> flagged;
+    uint64_t nonFiniteBlocks = 0;
+    uint64_t blockIndex = 0;
+
+    for (uint64_t frame = 0; frame < totalFrames; frame += input.size(), ++blockIndex) {
+        uint32_t frames = variableBlocks ? blockDist(rng) : blockSize;
+        input.resize(frames);
+        output.resize(frames);
+
+        generator.generate(input.data(), frames);
+
+        int changed = -1;
+        if (unitDist(rng) < changeProbability)
+            changed = (int)randomParameterChange(*dsp, rng);
+
+        uint64_t t0 = benchReadNanoseconds();
+        dsp->run(input.data(), output.data(), frames);
+        uint64_t t1 = benchReadNanoseconds();
+
+        double seconds = 1e-9 * (t1 - t0);
+        double share = seconds / (frames / kSampleRate);
+        times.push_back(share);
+
+        for (uint32_t i = 0; i < frames; ++i) {
+            if (!benchIsFinite(output[i])) {
+                ++nonFiniteBlocks;
+                break;
+            }
+        }
+
+        if (share > deadlineLimit) {
+            BlockTiming bt;
+            bt.index = blockIndex;
+            bt.frames = frames;
+            bt.seconds = seconds;
+            bt.deadlineShare = share;
+            bt.oversampling = (int)dsp->getParameterValue(pIdOversampling);
+            bt.changedParameter = changed;
+            bt.segment = generator.currentKind();
+            flagged.push_back(bt);
+        }
+    }
+
+    std::vector<double> sorted(times);
+    std::sort(sorted.begin(), sorted.end());
+
+    BenchJsonWriter json(stream);
+    json.begin("quadrafuzz-stress");
+
+    json.beginResult();
+    json.field("name", "summary");
+    json.field("blocks", (long)times.size());
+    json.field("block_size", (long)blockSize);
+    json.field("variable_blocks", (long)variableBlocks);
+    json.field("seed", (long)seed);
+    json.field("deadline_limit", deadlineLimit);
+    json.field("p50", percentile(sorted, 0.50));
+    json.field("p99", percentile(sorted, 0.99));
+    json.field("p999", percentile(sorted, 0.999));
+    json.field("max", sorted.empty() ? 0.0 : sorted.back());
+    json.field("flagged_blocks", (long)flagged.size());
+    json.field("nonfinite_output_blocks", (long)nonFiniteBlocks);
+    json.endResult();
+
+    std::sort(flagged.begin(), flagged.end(), [](const BlockTiming &a, const BlockTiming &b) {
+        return a.deadlineShare > b.deadlineShare;
+    });
+    for (size_t i = 0, n = std::min<size_t>(flagged.size(), 100); i < n; ++i) {
+        const BlockTiming &bt = flagged[i];
+        json.beginResult();
+        json.field("name", "flagged");
+        json.field("block", (long)bt.index);
+        json.field("frames", (long)bt.frames);
+        json.field("seconds", bt.seconds);
+        json.field("deadline_share", bt.deadlineShare);
+        json.field("oversampling", (long)bt.oversampling);
+        json.field("changed_parameter", (long)bt.changedParameter);
+        json.field("segment", segmentNames[bt.segment]);
+        json.endResult();
+    }
+
+    json.end();
+
+    if (stream != stdout)
+        fclose(stream);
+
+    fprintf(stderr, "%zu blocks, deadline share p50 %.4f p99 %.4f p99.9 %.4f max %.4f, %zu flagged above %.2f\n",
+            times.size(), percentile(sorted, 0.50), percentile(sorted, 0.99),
+            percentile(sorted, 0.999), sorted.empty() ? 0.0 : sorted.back(),
+            flagged.size(), deadlineLimit);
+
+    return (strict && !flagged.empty()) ? 1 : 0;
+}
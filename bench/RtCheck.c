@@ -0,0 +1,300 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#define _GNU_SOURCE 1
+#include "RtCheck.h"
+#include <dlfcn.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/select.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+static __thread int rtcheck_active;
+static int rtcheck_abort;
+static struct rtcheck_report rtcheck_data;
+
+void rtcheck_violation(const char *name)
+{
+    struct rtcheck_report *r = &rtcheck_data;
+    unsigned i;
+
+    /* this must not itself allocate or lock */
+    __atomic_add_fetch(&r->count, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < r->num_names && r->names[i] != name; ++i);
+    if (i == r->num_names && i < RTCHECK_MAX_NAMES)
+        r->names[r->num_names++] = name;
+    if (i < RTCHECK_MAX_NAMES)
+        ++r->name_counts[i];
+
+    if (rtcheck_abort)
+        abort();
+}
+
+#define RTCHECK_ENTER(name)                     \
+    do {                                        \
+        if (rtcheck_active)                     \
+            rtcheck_violation(name);            \
+    } while (0)
+
+void rtcheck_begin(void)
+{
+    rtcheck_active = 1;
+}
+
+void rtcheck_end(void)
+{
+    rtcheck_active = 0;
+}
+
+const struct rtcheck_report *rtcheck_get_report(void)
+{
+    return &rtcheck_data;
+}
+
+void rtcheck_reset(void)
+{
+    memset(&rtcheck_data, 0, sizeof(rtcheck_data));
+}
+
+/* -------------------------------------------------------------------- */
+/* memory allocation, forwarded to the glibc internals; dlsym can't be
+ * used for these, because it allocates itself */
+
+extern void *__libc_malloc(size_t);
+extern void __libc_free(void *);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void *__libc_memalign(size_t, size_t);
+extern void *__libc_valloc(size_t);
+
+void *malloc(size_t size)
+{
+    RTCHECK_ENTER("malloc");
+    return __libc_malloc(size);
+}
+
+void free(void *ptr)
+{
+    RTCHECK_ENTER("free");
+    __libc_free(ptr);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    RTCHECK_ENTER("calloc");
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    RTCHECK_ENTER("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t align, size_t size)
+{
+    RTCHECK_ENTER("memalign");
+    return __libc_memalign(align, size);
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    RTCHECK_ENTER("aligned_alloc");
+    return __libc_memalign(align, size);
+}
+
+void *valloc(size_t size)
+{
+    RTCHECK_ENTER("valloc");
+    return __libc_valloc(size);
+}
+
+int posix_memalign(void **ptr, size_t align, size_t size)
+{
+    RTCHECK_ENTER("posix_memalign");
+    void *mem = __libc_memalign(align, size);
+    if (!mem)
+        return ENOMEM;
+    *ptr = mem;
+    return 0;
+}
+
+/* -------------------------------------------------------------------- */
+/* locks, waits, I/O and other system calls, forwarded via dlsym */
+
+#define RTCHECK_FORWARDS(X)                                                                 \
+    X(int, pthread_mutex_lock, (pthread_mutex_t *m), (m))                                   \
+    X(int, pthread_mutex_trylock, (pthread_mutex_t *m), (m))                                \
+    X(int, pthread_mutex_timedlock, (pthread_mutex_t *m, const struct timespec *t), (m, t)) \
+    X(int, pthread_mutex_unlock, (pthread_mutex_t *m), (m))                                 \
+    X(int, pthread_rwlock_rdlock, (pthread_rwlock_t *l), (l))                               \
+    X(int, pthread_rwlock_wrlock, (pthread_rwlock_t *l), (l))                               \
+    X(int, pthread_spin_lock, (pthread_spinlock_t *l), (l))                                 \
+    X(int, pthread_cond_wait, (pthread_cond_t *c, pthread_mutex_t *m), (c, m))              \
+    X(int, pthread_cond_timedwait, (pthread_cond_t *c, pthread_mutex_t *m,                  \
+                                    const struct timespec *t), (c, m, t))                   \
+    X(int, pthread_cond_signal, (pthread_cond_t *c), (c))                                   \
+    X(int, pthread_cond_broadcast, (pthread_cond_t *c), (c))                                \
+    X(int, pthread_join, (pthread_t t, void **r), (t, r))                                   \
+    X(int, pthread_create, (pthread_t *t, const pthread_attr_t *a,                          \
+                            void *(*f)(void *), void *p), (t, a, f, p))                     \
+    X(int, sem_wait, (sem_t *s), (s))                                                       \
+    X(int, sem_timedwait, (sem_t *s, const struct timespec *t), (s, t))                     \
+    X(int, nanosleep, (const struct timespec *r, struct timespec *m), (r, m))               \
+    X(int, clock_nanosleep, (clockid_t c, int f, const struct timespec *r,                  \
+                             struct timespec *m), (c, f, r, m))                             \
+    X(int, usleep, (useconds_t u), (u))                                                     \
+    X(unsigned, sleep, (unsigned s), (s))                                                   \
+    X(int, sched_yield, (void), ())                                                         \
+    X(ssize_t, read, (int fd, void *b, size_t n), (fd, b, n))                               \
+    X(ssize_t, write, (int fd, const void *b, size_t n), (fd, b, n))                        \
+    X(int, close, (int fd), (fd))                                                           \
+    X(int, poll, (struct pollfd *f, nfds_t n, int t), (f, n, t))                            \
+    X(int, select, (int n, fd_set *r, fd_set *w, fd_set *e, struct timeval *t),             \
+      (n, r, w, e, t))                                                                      \
+    X(void *, mmap, (void *a, size_t l, int p, int f, int fd, off_t o), (a, l, p, f, fd, o)) \
+    X(int, munmap, (void *a, size_t l), (a, l))                                             \
+    X(int, mprotect, (void *a, size_t l, int p), (a, l, p))                                 \
+    X(int, madvise, (void *a, size_t l, int d), (a, l, d))                                  \
+    X(int, mlock, (const void *a, size_t l), (a, l))                                        \
+    X(void *, sbrk, (intptr_t i), (i))                                                      \
+    X(FILE *, fopen, (const char *p, const char *m), (p, m))                                \
+    X(int, fclose, (FILE *f), (f))                                                          \
+    X(size_t, fwrite, (const void *p, size_t s, size_t n, FILE *f), (p, s, n, f))           \
+    X(int, fflush, (FILE *f), (f))                                                          \
+    X(int, fputs, (const char *s, FILE *f), (s, f))                                         \
+    X(int, puts, (const char *s), (s))                                                      \
+    X(int, vprintf, (const char *f, va_list a), (f, a))                                     \
+    X(int, vfprintf, (FILE *s, const char *f, va_list a), (s, f, a))
+
+#define RTCHECK_DECLARE_NEXT(ret, name, params, args) \
+    static ret (*next_##name) params;
+RTCHECK_FORWARDS(RTCHECK_DECLARE_NEXT)
+
+#define RTCHECK_DEFINE_FORWARD(ret, name, params, args) \
+    ret name params                                     \
+    {                                                   \
+        RTCHECK_ENTER(#name);                           \
+        return next_##name args;                        \
+    }
+RTCHECK_FORWARDS(RTCHECK_DEFINE_FORWARD)
+
+static int (*next_open)(const char *, int, ...);
+static int (*next_openat)(int, const char *, int, ...);
+static int (*next_ioctl)(int, unsigned long, ...);
+static long (*next_syscall)(long, ...);
+
+int open(const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    RTCHECK_ENTER("open");
+    return next_open(path, flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    RTCHECK_ENTER("openat");
+    return next_openat(dirfd, path, flags, mode);
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+    va_list ap;
+    va_start(ap, request);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+    RTCHECK_ENTER("ioctl");
+    return next_ioctl(fd, request, arg);
+}
+
+long syscall(long number, ...)
+{
+    long a[6];
+    va_list ap;
+    va_start(ap, number);
+    for (unsigned i = 0; i < 6; ++i)
+        a[i] = va_arg(ap, long);
+    va_end(ap);
+    RTCHECK_ENTER("syscall");
+    return next_syscall(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+int printf(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    int ret = vprintf(format, ap);
+    va_end(ap);
+    return ret;
+}
+
+int fprintf(FILE *stream, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    int ret = vfprintf(stream, format, ap);
+    va_end(ap);
+    return ret;
+}
+
+/* -------------------------------------------------------------------- */
+
+void rtcheck_init(int abort_on_violation)
+{
+    rtcheck_abort = abort_on_violation;
+
+#define RTCHECK_RESOLVE_NEXT(ret, name, params, args) \
+    next_##name = (ret (*) params)dlsym(RTLD_NEXT, #name);
+    RTCHECK_FORWARDS(RTCHECK_RESOLVE_NEXT)
+
+    next_open = (int (*)(const char *, int, ...))dlsym(RTLD_NEXT, "open");
+    next_openat = (int (*)(int, const char *, int, ...))dlsym(RTLD_NEXT, "openat");
+    next_ioctl = (int (*)(int, unsigned long, ...))dlsym(RTLD_NEXT, "ioctl");
+    next_syscall = (long (*)(long, ...))dlsym(RTLD_NEXT, "syscall");
+
+    rtcheck_reset();
+}
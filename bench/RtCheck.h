@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Interposition of the calls which are forbidden on the audio thread:
+ * memory allocation, locks, sleeps, standard I/O and system calls.
+ * Calls made by the current thread while the check is active count as
+ * violations.
+ */
+
+enum { RTCHECK_MAX_NAMES = 64 };
+
+struct rtcheck_report {
+    unsigned count;
+    unsigned num_names;
+    const char *names[RTCHECK_MAX_NAMES];
+    unsigned name_counts[RTCHECK_MAX_NAMES];
+};
+
+/* resolve the real functions, call before anything else */
+void rtcheck_init(int abort_on_violation);
+
+/* enter and leave the checked section, on the current thread */
+void rtcheck_begin(void);
+void rtcheck_end(void);
+
+/* violations since the last reset */
+const struct rtcheck_report *rtcheck_get_report(void);
+void rtcheck_reset(void);
+
+/* record a violation from the outside, eg. a page fault */
+void rtcheck_violation(const char *name);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+/**
+ * Array of fixed size, zero-filled, and aligned for SIMD and cache lines.
+ *
+ * It is allocated outside of the processing, and the zero-fill touches
+ * all its pages, so that using it in real time does not fault.
+ */
+template <class T, size_t Alignment = 64>
+class AlignedBuffer
+{
+public:
+    AlignedBuffer() = default;
+    explicit AlignedBuffer(size_t count) { resize(count); }
+    ~AlignedBuffer() { std::free(fAllocation); }
+
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    void resize(size_t count)
+    {
+        void *allocation = nullptr;
+        if (count > 0) {
+            allocation = std::malloc(count * sizeof(T) + Alignment - 1);
+            if (!allocation)
+                throw std::bad_alloc();
+        }
+
+        std::free(fAllocation);
+        fAllocation = allocation;
+        fData = nullptr;
+        fSize = count;
+
+        if (allocation) {
+            uintptr_t address = ((uintptr_t)allocation + Alignment - 1) & ~(uintptr_t)(Alignment - 1);
+            fData = (T *)address;
+            std::memset(fData, 0, count * sizeof(T));
+        }
+    }
+
+    T *data() { return fData; }
+    const T *data() const { return fData; }
+    size_t size() const { return fSize; }
+
+    T &operator[](size_t i) { return fData[i]; }
+    const T &operator[](size_t i) const { return fData[i]; }
+
+private:
+    void *fAllocation = nullptr;
+    T *fData = nullptr;
+    size_t fSize = 0;
+};
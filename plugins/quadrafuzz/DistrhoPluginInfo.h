@@ -22,13 +22,38 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
 
+/* the number of bands, which each build of the plugin fixes */
+#ifndef QUADRAFUZZ_BANDS
+#   define QUADRAFUZZ_BANDS 4
+#endif
+
+#if QUADRAFUZZ_BANDS == 4
+#   define DISTRHO_PLUGIN_NAME         "Quadrafuzz"
+#   define DISTRHO_PLUGIN_URI          "http://jpcima.sdf1.org/lv2/quadrafuzz"
+#   define DISTRHO_PLUGIN_UNIQUE_ID    'q','d','f','z'
+#   define DISTRHO_PLUGIN_LABEL        "Quadrafuzz"
+#elif QUADRAFUZZ_BANDS == 2
+#   define DISTRHO_PLUGIN_NAME         "Quadrafuzz 2-band"
+#   define DISTRHO_PLUGIN_URI          "http://jpcima.sdf1.org/lv2/quadrafuzz-2band"
+#   define DISTRHO_PLUGIN_UNIQUE_ID    'q','d','f','2'
+#   define DISTRHO_PLUGIN_LABEL        "Quadrafuzz2Band"
+#elif QUADRAFUZZ_BANDS == 6
+#   define DISTRHO_PLUGIN_NAME         "Quadrafuzz 6-band"
+#   define DISTRHO_PLUGIN_URI          "http://jpcima.sdf1.org/lv2/quadrafuzz-6band"
+#   define DISTRHO_PLUGIN_UNIQUE_ID    'q','d','f','6'
+#   define DISTRHO_PLUGIN_LABEL        "Quadrafuzz6Band"
+#elif QUADRAFUZZ_BANDS == 8
+#   define DISTRHO_PLUGIN_NAME         "Quadrafuzz 8-band"
+#   define DISTRHO_PLUGIN_URI          "http://jpcima.sdf1.org/lv2/quadrafuzz-8band"
+#   define DISTRHO_PLUGIN_UNIQUE_ID    'q','d','f','8'
+#   define DISTRHO_PLUGIN_LABEL        "Quadrafuzz8Band"
+#else
+#   error "QUADRAFUZZ_BANDS must be one of 2, 4, 6 or 8"
+#endif
+
 #define DISTRHO_PLUGIN_BRAND           "Jean Pierre Cimalando"
-#define DISTRHO_PLUGIN_NAME            "Quadrafuzz"
-#define DISTRHO_PLUGIN_URI             "http://jpcima.sdf1.org/lv2/quadrafuzz"
 #define DISTRHO_PLUGIN_HOMEPAGE        "https://github.com/jpcima/quadrafuzz"
-#define DISTRHO_PLUGIN_UNIQUE_ID       'q','d','f','z'
 #define DISTRHO_PLUGIN_VERSION         0,0,0
-#define DISTRHO_PLUGIN_LABEL           "Quadrafuzz"
 #define DISTRHO_PLUGIN_LICENSE         "http://spdx.org/licenses/GPL-3.0-or-later"
 #define DISTRHO_PLUGIN_MAKER           "Jean Pierre Cimalando"
 #define DISTRHO_PLUGIN_DESCRIPTION     "Multi-band fuzz distortion"
@@ -40,8 +65,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define DISTRHO_PLUGIN_HAS_EXTERNAL_UI 0
 #define DISTRHO_PLUGIN_IS_RT_SAFE      1
 #define DISTRHO_PLUGIN_WANT_PROGRAMS   0
-#define DISTRHO_PLUGIN_WANT_STATE      0
+#define DISTRHO_PLUGIN_WANT_STATE      1
 #define DISTRHO_PLUGIN_WANT_FULL_STATE 0
+#define DISTRHO_PLUGIN_WANT_LATENCY    1
 #define DISTRHO_PLUGIN_NUM_PROGRAMS    0
 
 enum {
@@ -51,16 +77,35 @@ enum {
     pIdOutputGain,
     pIdDryGain,
     pIdWetGain,
-    pIdLowDrive,
-    pIdMidLowDrive,
-    pIdMidHighDrive,
-    pIdHighDrive,
-    pIdOversampling,
+    /* the drives of the bands, from the lowest */
+    pIdDrive,
+    pIdOversampling = pIdDrive + QUADRAFUZZ_BANDS,
+    pIdDspLoad,
+    pIdDspLoadPeak,
+    /* the mutes and the solos of the bands, from the lowest */
+    pIdMute,
+    pIdSolo = pIdMute + QUADRAFUZZ_BANDS,
+    /* whether the bands are processed, or gated for lack of signal */
+    pIdActivity = pIdSolo + QUADRAFUZZ_BANDS,
+    /* the level of aliasing which the automatic oversampling allows */
+    pIdAliasBudget = pIdActivity + QUADRAFUZZ_BANDS,
+    /* the share of the block duration which the processing may take, and
+       the oversampling which runs under this limit */
+    pIdCpuBudget,
+    pIdEffectiveOversampling,
 
     Parameter_Count
 };
 
 enum {
     /* state IDs */
+    /* the path of the WAV file of the impulse response of the cabinet */
+    sIdImpulseResponse,
+    /* whether the processing is pipelined over a helper thread, "1" or "0" */
+    sIdPipeline,
+    /* whether offline rendering is detected from the pace of the blocks,
+       "1" or "0" */
+    sIdOfflineDetection,
+
     State_Count
 };
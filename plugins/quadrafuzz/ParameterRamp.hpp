@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/**
+ * Value which moves linearly to a target, over a number of frames.
+ */
+class LinearRamp
+{
+public:
+    void setValue(float value)
+    {
+        fValue = fTarget = value;
+        fStep = 0;
+        fRemaining = 0;
+    }
+
+    void setTarget(float target, uint32_t frames)
+    {
+        if (target == fTarget)
+            return;
+        if (frames == 0) {
+            setValue(target);
+            return;
+        }
+        fTarget = target;
+        fStep = (target - fValue) / frames;
+        fRemaining = frames;
+    }
+
+    bool isRamping() const { return fRemaining > 0; }
+    float getValue() const { return fValue; }
+    float getTarget() const { return fTarget; }
+    float getStep() const { return fStep; }
+    uint32_t getRemaining() const { return fRemaining; }
+
+    void advance(uint32_t frames)
+    {
+        if (frames >= fRemaining) {
+            fValue = fTarget;
+            fStep = 0;
+            fRemaining = 0;
+        }
+        else {
+            fValue += frames * fStep;
+            fRemaining -= frames;
+        }
+    }
+
+private:
+    float fValue = 0;
+    float fTarget = 0;
+    float fStep = 0;
+    uint32_t fRemaining = 0;
+};
+
+/**
+ * Gain which moves linearly in dB to a target, over a number of frames.
+ *
+ * The linear gain is exact every `kSegmentFrames` and at the end of the
+ * ramp, and interpolated linearly in between, whatever the size of the
+ * chunks which are generated.
+ */
+class GainRamp
+{
+public:
+    enum { kSegmentFrames = 64 };
+
+    void setValue(float db, float linear)
+    {
+        fDb.setValue(db);
+        fLinear = fTargetLinear = linear;
+    }
+
+    void setTarget(float db, float linear, uint32_t frames)
+    {
+        if (db == fDb.getTarget())
+            return;
+        fDb.setTarget(db, frames);
+        fTargetLinear = linear;
+        if (!fDb.isRamping())
+            fLinear = linear;
+    }
+
+    bool isRamping() const { return fDb.isRamping(); }
+    float getLinear() const { return fLinear; }
+
+    /* writes the linear gains of the next frames, and advances; the target
+       is held once reached, so that a long block keeps the ramp length */
+    void generate(float *gain, uint32_t frames)
+    {
+        uint32_t i = 0;
+        while (i < frames && fDb.isRamping()) {
+            uint32_t n = std::min(frames - i, std::min(fDb.getRemaining(), (uint32_t)kSegmentFrames));
+            float g0 = fLinear;
+            fDb.advance(n);
+            float g1 = fDb.isRamping() ? std::pow(10.0f, 0.05f * fDb.getValue()) : fTargetLinear;
+            float dg = (g1 - g0) / n;
+            for (uint32_t j = 0; j < n; ++j)
+                gain[i + j] = g0 + j * dg;
+            fLinear = g1;
+            i += n;
+        }
+        for (; i < frames; ++i)
+            gain[i] = fLinear;
+    }
+
+private:
+    LinearRamp fDb;
+    float fLinear = 1;
+    float fTargetLinear = 1;
+};
@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "QuadrafuzzAliasModel.hpp"
+#include <algorithm>
+#include <cmath>
+
+const QuadrafuzzAliasModel &QuadrafuzzAliasModel::get()
+{
+    static const QuadrafuzzAliasModel model;
+    return model;
+}
+
+QuadrafuzzAliasModel::QuadrafuzzAliasModel()
+{
+    // integrate the odd harmonics over a quarter of the period, where the
+    // sine is positive, by the midpoint rule
+    const unsigned points = 16 * kHarmonics;
+    const double step = 0.5 * M_PI / points;
+
+    for (unsigned k = 0; k < kRatioSteps; ++k) {
+        double r = kMinRatio * std::pow(10.0, double(k) / kStepsPerDecade);
+
+        double harmonic[kHarmonics] = {};
+        for (unsigned m = 0; m < points; ++m) {
+            double theta = (m + 0.5) * step;
+            double s = std::sin(theta);
+            double y = s / (1 + r * s);
+
+            // sin(n * theta) of the odd n, by the recurrence of Chebyshev
+            double twoCos = 2 * std::cos(2 * theta);
+            double previous = -s, current = s;
+            for (unsigned j = 0; j < kHarmonics; ++j) {
+                harmonic[j] += y * current;
+                double next = twoCos * current - previous;
+                previous = current;
+                current = next;
+            }
+        }
+
+        // past the last harmonic, continue with the decay in 1/n^p of the
+        // last octave, at least in 1/n, as the shaper tends to a square wave
+        unsigned n1 = kHarmonics - 1, n2 = 2 * kHarmonics - 1;
+        double last = harmonic[kHarmonics - 1] * step * (4 / M_PI);
+        double p = std::log(std::fabs(harmonic[kHarmonics / 2 - 1] / harmonic[kHarmonics - 1])) / std::log(double(n2) / n1);
+        p = std::max(1.0, std::min(p, 8.0));
+        fDecay[k] = 2 * p - 1;
+        double tail = 0.25 * last * last * n2 / fDecay[k];
+        for (unsigned j = kHarmonics; j-- > 0;) {
+            double amplitude = harmonic[j] * step * (4 / M_PI);
+            tail += 0.5 * amplitude * amplitude;
+            fTail[k][j] = tail;
+        }
+    }
+}
+
+float QuadrafuzzAliasModel::aliasEnergy(float amplitude, float frequency, float foldFrequency, float gain, float scale) const
+{
+    float pi = M_PI;
+    float level = scale * amplitude / pi;
+    float r = gain * amplitude / pi;
+    if (r <= 0)
+        return 0;
+
+    // the first odd harmonic which aliases, never the fundamental; the
+    // conversions are clamped as integers, which also covers a NaN
+    float harmonic = std::min(foldFrequency / frequency, 1e6f);
+    int j = (int)std::ceil(0.5f * (harmonic - 1));
+    j = std::max(j, 1);
+
+    // the position of r in the table, which scales with r^2 below it
+    float position = (std::log10(r) - std::log10(kMinRatio)) * kStepsPerDecade;
+    float below = 1;
+    if (position < 0) {
+        float x = r / kMinRatio;
+        below = x * x;
+        position = 0;
+    }
+    int k = (int)position;
+    k = std::max(0, std::min(k, (int)kRatioSteps - 2));
+    float mu = std::min(position - k, 1.0f);
+
+    // beyond the table, the tail decays like at the end of the table
+    float tailScale = 1;
+    if (j >= kHarmonics) {
+        float decay = fDecay[k] + mu * (fDecay[k + 1] - fDecay[k]);
+        tailScale = std::pow(float(2 * kHarmonics - 1) / (2 * j + 1), decay);
+        j = kHarmonics - 1;
+    }
+
+    float tail = fTail[k][j] + mu * (fTail[k + 1][j] - fTail[k][j]);
+    return level * level * below * tailScale * tail;
+}
@@ -0,0 +1,59 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+/**
+ * An estimate of the aliasing of the waveshaper, `scale * x / (pi + gain * |x|)`.
+ *
+ * For a sine of amplitude `A`, the shape of the output only depends on
+ * `r = gain * A / pi`, and it has odd harmonics only. Their energies are
+ * tabulated against `r`, as the sums of the tail from each harmonic, so an
+ * estimate costs a lookup. The harmonics from the frequency where they fold
+ * back into the audible band are counted as aliases.
+ *
+ * The table is computed at the first call of `get`, which must not happen
+ * on the audio thread.
+ */
+class QuadrafuzzAliasModel
+{
+public:
+    static const QuadrafuzzAliasModel &get();
+
+    /* the mean square of the aliases, for a sine of `amplitude` at `frequency`,
+       when the harmonics from `foldFrequency` upwards alias */
+    float aliasEnergy(float amplitude, float frequency, float foldFrequency, float gain, float scale) const;
+
+private:
+    QuadrafuzzAliasModel();
+
+    /* `r` from `kMinRatio` in steps of 1/8 decade, and the odd harmonics up to 255 */
+    enum { kRatioSteps = 49, kStepsPerDecade = 8, kHarmonics = 128 };
+    static constexpr float kMinRatio = 1e-3f;
+
+    /* the energy of the harmonics from `2 * j + 1` upwards, relative to
+       `(scale * A / pi)^2`, at the ratio of each step */
+    float fTail[kRatioSteps][kHarmonics];
+    /* the exponent of the decay of the tail, past the last harmonic */
+    float fDecay[kRatioSteps];
+};
@@ -0,0 +1,99 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+/**
+ * The design of a band: the filter which isolates it, and the default of
+ * its drive. The lowest band is a lowpass, the highest a highpass, and
+ * those between are bandpasses, all with a Q of 1/sqrt(2).
+ *
+ * The symbol and the name prefix those of the parameters of the band.
+ */
+struct QuadrafuzzBand {
+    const char *symbol;
+    const char *name;
+    double frequency;
+    float drive;
+};
+
+/**
+ * The bands of each of the supported band counts.
+ */
+template <unsigned NBands> struct QuadrafuzzBandLayout;
+
+template <> struct QuadrafuzzBandLayout<2> {
+    static const QuadrafuzzBand *get()
+    {
+        static const QuadrafuzzBand bands[2] = {
+            {"Low", "Low", 700.0, 0.6f},
+            {"High", "High", 1400.0, 0.6f},
+        };
+        return bands;
+    }
+};
+
+template <> struct QuadrafuzzBandLayout<4> {
+    static const QuadrafuzzBand *get()
+    {
+        static const QuadrafuzzBand bands[4] = {
+            {"Low", "Low", 147.0, 0.6f},
+            {"MidLow", "Mid-Low", 587.0, 0.8f},
+            {"MidHigh", "Mid-High", 2490.0, 0.5f},
+            {"High", "High", 4980.0, 0.6f},
+        };
+        return bands;
+    }
+};
+
+template <> struct QuadrafuzzBandLayout<6> {
+    static const QuadrafuzzBand *get()
+    {
+        static const QuadrafuzzBand bands[6] = {
+            {"Low", "Low", 147.0, 0.6f},
+            {"LowMid", "Low-Mid", 330.0, 0.7f},
+            {"Mid", "Mid", 740.0, 0.8f},
+            {"UpperMid", "Upper-Mid", 1660.0, 0.6f},
+            {"Presence", "Presence", 3720.0, 0.5f},
+            {"High", "High", 6000.0, 0.6f},
+        };
+        return bands;
+    }
+};
+
+template <> struct QuadrafuzzBandLayout<8> {
+    static const QuadrafuzzBand *get()
+    {
+        static const QuadrafuzzBand bands[8] = {
+            {"Sub", "Sub", 110.0, 0.5f},
+            {"Bass", "Bass", 196.0, 0.6f},
+            {"LowMid", "Low-Mid", 350.0, 0.7f},
+            {"Mid", "Mid", 620.0, 0.8f},
+            {"UpperMid", "Upper-Mid", 1100.0, 0.7f},
+            {"Presence", "Presence", 1960.0, 0.6f},
+            {"Brilliance", "Brilliance", 3500.0, 0.5f},
+            {"Air", "Air", 6200.0, 0.6f},
+        };
+        return bands;
+    }
+};
@@ -0,0 +1,283 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "QuadrafuzzConvolver.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+QuadrafuzzConvolver::QuadrafuzzConvolver(const QuadrafuzzKernels &kernels, const float *response, uint32_t length)
+    : fKernels(&kernels),
+      fFFT(2 * kMinPartition),
+      fLength(length),
+      fPartition(kMinPartition),
+      fFarFFT(2 * std::max<uint32_t>(kMinPartition, chooseFarPartitionSize(length))),
+      fFarPartition(std::max<uint32_t>(kMinPartition, chooseFarPartitionSize(length)))
+{
+    const uint32_t partition = fPartition;
+    const uint32_t farPartition = fFarPartition;
+    fFarPartitions = (farPartition != partition) ? (length - 1) / farPartition - 1 : 0;
+    const uint32_t nearLength = fFarPartitions ? 2 * farPartition : length;
+
+    fHeadLength = std::min(nearLength, partition);
+    fTailPartitions = (nearLength > partition) ? (nearLength - 1) / partition : 0;
+    fBins = fFFT.getBins();
+    fBinStride = (fBins + 15) & ~15u;
+
+    fHead.resize(std::max<uint32_t>(1, fHeadLength));
+    for (uint32_t t = 0; t < fHeadLength; ++t)
+        fHead[t] = response[fHeadLength - 1 - t];
+
+    // each partition of the tail, in the first half of the window of the
+    // transform, so that the second half of the circular convolution with
+    // the last `2 B` inputs is the linear convolution
+    fTailSpectra.resize(2 * fTailPartitions * fBinStride);
+    AlignedBuffer<float> window(2 * partition);
+    const float scale = 1.0f / (2 * partition);
+    for (uint32_t k = 0; k < fTailPartitions; ++k) {
+        uint32_t start = (k + 1) * partition;
+        uint32_t count = std::min(partition, nearLength - start);
+        std::fill(window.data(), window.data() + 2 * partition, 0.0f);
+        for (uint32_t t = 0; t < count; ++t)
+            window[t] = scale * response[start + t];
+        fFFT.forward(window.data(), spectrumRe(fTailSpectra, k), spectrumIm(fTailSpectra, k));
+    }
+
+    fDelayLineSize = std::max<uint32_t>(1, fTailPartitions - (fTailPartitions > 0));
+    fDelayLine.resize(2 * fDelayLineSize * fBinStride);
+    fAccumulator.resize(2 * fBinStride);
+    fInputs.resize(2 * partition);
+    fTailOutput.resize(partition);
+    fWork.resize(2 * partition);
+
+    // the partitions of the far part in the same way, from `2 B`
+    fFarBins = fFarFFT.getBins();
+    fFarBinStride = (fFarBins + 15) & ~15u;
+    const uint32_t farSpectra = std::max<uint32_t>(1, fFarPartitions);
+    fFarSpectra.resize(2 * farSpectra * fFarBinStride);
+    AlignedBuffer<float> farWindow(2 * farPartition);
+    const float farScale = 1.0f / (2 * farPartition);
+    for (uint32_t k = 0; k < fFarPartitions; ++k) {
+        uint32_t start = (k + 2) * farPartition;
+        uint32_t count = std::min(farPartition, length - start);
+        std::fill(farWindow.data(), farWindow.data() + 2 * farPartition, 0.0f);
+        for (uint32_t t = 0; t < count; ++t)
+            farWindow[t] = farScale * response[start + t];
+        fFarFFT.forward(farWindow.data(), farSpectrumRe(fFarSpectra, k), farSpectrumIm(fFarSpectra, k));
+    }
+
+    fFarDelayLine.resize(2 * farSpectra * fFarBinStride);
+    fFarAccumulator.resize(2 * fFarBinStride);
+    fFarInputs.resize(3 * farPartition);
+    fFarOutput.resize(farPartition);
+    fFarWork.resize(2 * farPartition);
+}
+
+uint32_t QuadrafuzzConvolver::chooseFarPartitionSize(uint32_t length)
+{
+    // in the time of a tap of the head, per sample, as measured: a partition
+    // costs about four with its complex products, and the two transforms of
+    // a part about 120 whatever their size; the near part alone, or up to
+    // `2 B` and the far part after
+    const uint32_t near = kMinPartition;
+    auto nearCost = [near](uint32_t length) -> double {
+        uint32_t tail = (length > near) ? (length - 1) / near : 0;
+        return near + 4.0 * tail + (tail ? 120 : 0);
+    };
+
+    uint32_t best = 0;
+    double bestCost = nearCost(length);
+    for (uint32_t partition = 2 * near; partition <= kMaxPartition && length > 2 * partition; partition *= 2) {
+        uint32_t far = (length - 1) / partition - 1;
+        double cost = nearCost(2 * partition) + 4.0 * far + 120;
+        if (cost < bestCost) {
+            best = partition;
+            bestCost = cost;
+        }
+    }
+    return best;
+}
+
+void QuadrafuzzConvolver::reset()
+{
+    std::fill(fDelayLine.data(), fDelayLine.data() + fDelayLine.size(), 0.0f);
+    std::fill(fAccumulator.data(), fAccumulator.data() + fAccumulator.size(), 0.0f);
+    std::fill(fInputs.data(), fInputs.data() + fInputs.size(), 0.0f);
+    std::fill(fTailOutput.data(), fTailOutput.data() + fTailOutput.size(), 0.0f);
+    fNewestSpectrum = 0;
+    fAccumulated = 0;
+    fPosition = 0;
+
+    std::fill(fFarDelayLine.data(), fFarDelayLine.data() + fFarDelayLine.size(), 0.0f);
+    std::fill(fFarAccumulator.data(), fFarAccumulator.data() + fFarAccumulator.size(), 0.0f);
+    std::fill(fFarInputs.data(), fFarInputs.data() + fFarInputs.size(), 0.0f);
+    std::fill(fFarOutput.data(), fFarOutput.data() + fFarOutput.size(), 0.0f);
+    fFarNewestSpectrum = 0;
+    fFarStepsDone = 0;
+    fFarCostDone = 0;
+    fFarPosition = 0;
+}
+
+void QuadrafuzzConvolver::process(const float *input, float *output, uint32_t frames)
+{
+    const QuadrafuzzKernels &k = *fKernels;
+    const uint32_t partition = fPartition;
+    const uint32_t headLength = fHeadLength;
+    const uint32_t farPartition = fFarPartition;
+    const uint32_t farCost = 2 * kTransformStepCost * fFarFFT.getStepCount() + fFarPartitions;
+
+    while (frames > 0) {
+        // the far period is a multiple of the near one, and they start
+        // together, so this also stops at the end of a far period
+        uint32_t n = std::min(frames, partition - fPosition);
+
+        // the inputs first, in case the output is the same buffer
+        float *current = &fInputs[partition + fPosition];
+        std::memcpy(current, input, n * sizeof(float));
+        if (fFarPartitions)
+            std::memcpy(&fFarInputs[2 * farPartition + fFarPosition], input, n * sizeof(float));
+
+        const float *tail = &fTailOutput[fPosition];
+        const float *far = &fFarOutput[fFarPosition];
+        for (uint32_t i = 0; i < n; ++i)
+            output[i] = k.dot(fHead.data(), current + i + 1 - headLength, headLength) + tail[i] + far[i];
+
+        // the products which this share of the period pays for
+        fPosition += n;
+        if (fTailPartitions > 1)
+            accumulateTail((uint64_t)(fTailPartitions - 1) * fPosition / partition);
+        if (fPosition == partition)
+            endPeriod();
+
+        // and the steps of the far part
+        fFarPosition += n;
+        if (fFarPartitions)
+            advanceFar((uint64_t)farCost * fFarPosition / farPartition);
+        if (fFarPosition == farPartition)
+            endFarPeriod();
+
+        input += n;
+        output += n;
+        frames -= n;
+    }
+}
+
+void QuadrafuzzConvolver::accumulateTail(uint32_t count)
+{
+    // the partition `k + 1` of the tail takes the spectrum which is `k - 1`
+    // periods older than the newest
+    float *accRe = spectrumRe(fAccumulator, 0);
+    float *accIm = spectrumIm(fAccumulator, 0);
+    for (; fAccumulated < count; ++fAccumulated) {
+        uint32_t k = fAccumulated + 1;
+        uint32_t slot = (fNewestSpectrum + fDelayLineSize - (k - 1)) % fDelayLineSize;
+        fKernels->spectrumMultiplyAdd(accRe, accIm,
+                                      spectrumRe(fDelayLine, slot), spectrumIm(fDelayLine, slot),
+                                      spectrumRe(fTailSpectra, k), spectrumIm(fTailSpectra, k), fBins);
+    }
+}
+
+void QuadrafuzzConvolver::endPeriod()
+{
+    const uint32_t partition = fPartition;
+
+    if (fTailPartitions > 0) {
+        // the spectrum of the last `2 B` inputs replaces the oldest, which
+        // the last partition used during this period
+        uint32_t slot = (fNewestSpectrum + 1) % fDelayLineSize;
+        float *re = spectrumRe(fDelayLine, slot);
+        float *im = spectrumIm(fDelayLine, slot);
+        fFFT.forward(fInputs.data(), re, im);
+        fNewestSpectrum = slot;
+
+        float *accRe = spectrumRe(fAccumulator, 0);
+        float *accIm = spectrumIm(fAccumulator, 0);
+        fKernels->spectrumMultiplyAdd(accRe, accIm, re, im,
+                                      spectrumRe(fTailSpectra, 0), spectrumIm(fTailSpectra, 0), fBins);
+        fFFT.inverse(accRe, accIm, fWork.data());
+        std::memcpy(fTailOutput.data(), &fWork[partition], partition * sizeof(float));
+
+        std::fill(fAccumulator.data(), fAccumulator.data() + fAccumulator.size(), 0.0f);
+        fAccumulated = 0;
+    }
+
+    // the inputs of this period become the previous ones
+    std::memcpy(fInputs.data(), &fInputs[partition], partition * sizeof(float));
+    fPosition = 0;
+}
+
+void QuadrafuzzConvolver::advanceFar(uint32_t cost)
+{
+    const uint32_t fftSteps = fFarFFT.getStepCount();
+    const uint32_t partitions = fFarPartitions;
+    const uint32_t steps = 2 * fftSteps + partitions;
+    float *accRe = farSpectrumRe(fFarAccumulator, 0);
+    float *accIm = farSpectrumIm(fFarAccumulator, 0);
+
+    for (; fFarStepsDone < steps; ++fFarStepsDone) {
+        // a step which ends nearer the cost than it starts
+        uint32_t step = fFarStepsDone;
+        bool transform = step < fftSteps || step >= fftSteps + partitions;
+        uint32_t stepCost = transform ? kTransformStepCost : 1;
+        if (2 * fFarCostDone + stepCost > 2 * cost)
+            break;
+        fFarCostDone += stepCost;
+
+        if (step < fftSteps) {
+            // the spectrum of the `2 B` inputs until the last period
+            // replaces the oldest, which the last partition used during it
+            uint32_t slot = (fFarNewestSpectrum + 1) % partitions;
+            fFarFFT.forwardStep(step, fFarInputs.data(), farSpectrumRe(fFarDelayLine, slot), farSpectrumIm(fFarDelayLine, slot));
+            if (step + 1 == fftSteps)
+                fFarNewestSpectrum = slot;
+        }
+        else if ((step -= fftSteps) < partitions) {
+            // the partition `k` takes the spectrum which is `k` periods
+            // older than the newest
+            uint32_t slot = (fFarNewestSpectrum + partitions - step) % partitions;
+            fKernels->spectrumMultiplyAdd(accRe, accIm,
+                                          farSpectrumRe(fFarDelayLine, slot), farSpectrumIm(fFarDelayLine, slot),
+                                          farSpectrumRe(fFarSpectra, step), farSpectrumIm(fFarSpectra, step), fFarBins);
+        }
+        else
+            fFarFFT.inverseStep(step - partitions, accRe, accIm, fFarWork.data());
+    }
+}
+
+void QuadrafuzzConvolver::endFarPeriod()
+{
+    const uint32_t farPartition = fFarPartition;
+
+    if (fFarPartitions > 0) {
+        std::memcpy(fFarOutput.data(), &fFarWork[farPartition], farPartition * sizeof(float));
+        std::fill(fFarAccumulator.data(), fFarAccumulator.data() + fFarAccumulator.size(), 0.0f);
+        fFarStepsDone = 0;
+        fFarCostDone = 0;
+
+        // the inputs of the last two periods become the ones before
+        std::memmove(fFarInputs.data(), &fFarInputs[farPartition], 2 * farPartition * sizeof(float));
+    }
+
+    fFarPosition = 0;
+}
@@ -0,0 +1,148 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#pragma once
+#include "QuadrafuzzKernels.hpp"
+#include "QuadrafuzzFFT.hpp"
+#include "AlignedBuffer.hpp"
+#include <cstdint>
+
+/**
+ * Convolution with an impulse response, without latency, by uniformly
+ * partitioned convolution in the frequency domain, with a direct head, in
+ * two parts of different partition sizes.
+ *
+ * The near part cuts the start of the response into partitions of
+ * `kMinPartition` samples. The first one is applied in the time domain,
+ * sample by sample. The others are applied by overlap-save, every partition,
+ * to the spectra of the last inputs, which a frequency-domain delay line
+ * keeps. The output of the tail for the next period only depends on the
+ * inputs up to now, so it is ready when they start, and the two together
+ * have no latency. The products of the partitions but the first are
+ * accumulated as the inputs of a period come, and at its end remain one FFT,
+ * the product of the first partition, and one inverse FFT.
+ *
+ * The far part cuts the rest of the response, from `2 B`, into partitions of
+ * a larger `B`, for a long response to cost less. Its output for a period
+ * only depends on the inputs up to two periods before, so all of its work,
+ * the FFT of the last inputs, the products and the inverse FFT, runs during
+ * the period between, in steps spread over the samples. So no block runs the
+ * large transforms at once, and the work of a block of `kMinPartition` or
+ * more frames does not vary with its place in the period.
+ *
+ * It allocates at construction, and `process` is real-time safe. The input
+ * and the output of `process` may be the same buffer.
+ */
+class QuadrafuzzConvolver
+{
+public:
+    QuadrafuzzConvolver(const QuadrafuzzKernels &kernels, const float *response, uint32_t length);
+
+    uint32_t getLength() const { return fLength; }
+    /* the partition size of the far part, or of the near one without it */
+    uint32_t getPartitionSize() const { return fFarPartitions ? fFarPartition : fPartition; }
+
+    /* clears the inputs which were seen */
+    void reset();
+
+    void process(const float *input, float *output, uint32_t frames);
+
+    /* the partition size of the far part which minimizes the work per
+       sample, or 0 if the near part alone costs less */
+    static uint32_t chooseFarPartitionSize(uint32_t length);
+
+    enum { kMinPartition = 64, kMaxPartition = 1024 };
+    /* the cost of a step of a transform, in products of partitions, as
+       measured */
+    enum { kTransformStepCost = 3 };
+
+private:
+    void accumulateTail(uint32_t count);
+    void endPeriod();
+    /* runs the steps of the far part up to a cost, in products of
+       partitions, so that each block does about the same work */
+    void advanceFar(uint32_t cost);
+    void endFarPeriod();
+
+    /* the real and imaginary parts of a spectrum in a buffer of spectra */
+    float *spectrumRe(AlignedBuffer<float> &buffer, uint32_t index) { return &buffer[2 * index * fBinStride]; }
+    float *spectrumIm(AlignedBuffer<float> &buffer, uint32_t index) { return &buffer[(2 * index + 1) * fBinStride]; }
+    float *farSpectrumRe(AlignedBuffer<float> &buffer, uint32_t index) { return &buffer[2 * index * fFarBinStride]; }
+    float *farSpectrumIm(AlignedBuffer<float> &buffer, uint32_t index) { return &buffer[(2 * index + 1) * fFarBinStride]; }
+
+    const QuadrafuzzKernels *fKernels;
+    QuadrafuzzFFT fFFT;
+
+    uint32_t fLength;
+    uint32_t fPartition;
+    /* the length of the head, and the number of the partitions after it */
+    uint32_t fHeadLength;
+    uint32_t fTailPartitions;
+    uint32_t fBins;
+    uint32_t fBinStride;
+
+    /* the head in reverse order, for a dot product with the inputs */
+    AlignedBuffer<float> fHead;
+    /* the spectra of the partitions of the tail, scaled for the inverse FFT */
+    AlignedBuffer<float> fTailSpectra;
+    /* the spectra of the last inputs, from the most recent, in a ring */
+    AlignedBuffer<float> fDelayLine;
+    uint32_t fDelayLineSize;
+    uint32_t fNewestSpectrum = 0;
+    /* the sum of the products for the next period */
+    AlignedBuffer<float> fAccumulator;
+    uint32_t fAccumulated = 0;
+
+    /* the inputs of the previous period, then the ones of this period */
+    AlignedBuffer<float> fInputs;
+    uint32_t fPosition = 0;
+    /* the output of the tail during this period, and the work of the IFFT */
+    AlignedBuffer<float> fTailOutput;
+    AlignedBuffer<float> fWork;
+
+    /* the far part, in partitions of `fFarPartition`, or none without any;
+       its period goes along the one of the near part */
+    QuadrafuzzFFT fFarFFT;
+    uint32_t fFarPartition;
+    uint32_t fFarPartitions;
+    uint32_t fFarBins;
+    uint32_t fFarBinStride;
+    /* the spectra of the partitions, and the ones of the last inputs, which
+       are as many, from the most recent, in a ring */
+    AlignedBuffer<float> fFarSpectra;
+    AlignedBuffer<float> fFarDelayLine;
+    uint32_t fFarNewestSpectrum = 0;
+    /* the sum of the products, and the steps of the work done this period,
+       from the FFT to the products to the inverse FFT, and their cost */
+    AlignedBuffer<float> fFarAccumulator;
+    uint32_t fFarStepsDone = 0;
+    uint32_t fFarCostDone = 0;
+    /* the inputs of the two previous periods, then the ones of this period */
+    AlignedBuffer<float> fFarInputs;
+    uint32_t fFarPosition = 0;
+    /* the output during this period, and the one for the next in the second
+       half of the work of the IFFT */
+    AlignedBuffer<float> fFarOutput;
+    AlignedBuffer<float> fFarWork;
+};
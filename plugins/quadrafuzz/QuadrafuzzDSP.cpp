@@ -0,0 +1,1593 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "QuadrafuzzDSP.hpp"
+#include "QuadrafuzzImpulse.hpp"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <chrono>
+#include <system_error>
+
+template <int Over, int FIRSize, int Taps>
+static QuadrafuzzKernels::FirState upsamplerState(EquirippleOversampler<Over, FIRSize, Taps> &os)
+{
+    return QuadrafuzzKernels::FirState{os.fir.up.c, os.fir.up.x, EquirippleOversampler<Over, FIRSize, Taps>::KernelTaps, os.fir.up.m, &os.fir.up.h};
+}
+
+template <int Over, int FIRSize, int Taps>
+static QuadrafuzzKernels::FirState downsamplerState(EquirippleOversampler<Over, FIRSize, Taps> &os)
+{
+    return QuadrafuzzKernels::FirState{os.fir.down.c, os.fir.down.x, EquirippleOversampler<Over, FIRSize, Taps>::KernelTaps, os.fir.down.m, &os.fir.down.h};
+}
+
+static QuadrafuzzKernels::FirState upsamplerState(DSP::NoOversampler &)
+{
+    return QuadrafuzzKernels::FirState{};
+}
+
+static QuadrafuzzKernels::FirState downsamplerState(DSP::NoOversampler &)
+{
+    return QuadrafuzzKernels::FirState{};
+}
+
+template <int Over, int FIRSize, int Taps>
+static void upsample(const QuadrafuzzKernels &k, EquirippleOversampler<Over, FIRSize, Taps> &os, const float *in, float *out, uint32_t frames)
+{
+    k.upsample(upsamplerState(os), Over, in, out, frames);
+}
+
+template <int Over, int FIRSize, int Taps>
+static void downsample(const QuadrafuzzKernels &k, EquirippleOversampler<Over, FIRSize, Taps> &os, const float *in, float *out, uint32_t frames)
+{
+    k.downsample(downsamplerState(os), Over, in, out, frames);
+}
+
+static void upsample(const QuadrafuzzKernels &, DSP::NoOversampler &, const float *, float *, uint32_t)
+{
+}
+
+static void downsample(const QuadrafuzzKernels &, DSP::NoOversampler &, const float *, float *, uint32_t)
+{
+}
+
+/* the largest power gain of a downsampler, from the Nyquist frequency of its output */
+static float stopbandGain(const QuadrafuzzKernels::FirState &fir, uint32_t over)
+{
+    const unsigned points = 256;
+    double gain = 0;
+    for (unsigned i = 0; i <= points; ++i) {
+        double w = M_PI / over + i * (M_PI - M_PI / over) / points;
+        double re = 0, im = 0;
+        for (uint32_t t = 0; t < fir.taps; ++t) {
+            re += fir.c[t] * std::cos(w * t);
+            im -= fir.c[t] * std::sin(w * t);
+        }
+        gain = std::max(gain, re * re + im * im);
+    }
+    return gain;
+}
+
+template <unsigned NBands>
+QuadrafuzzEngine<NBands>::QuadrafuzzEngine()
+    : fKernels(&selectKernels()),
+      fAliasModel(&QuadrafuzzAliasModel::get())
+{
+    for (unsigned b = 0; b < Bands; ++b)
+        fPending.shaper[b] = shaperCoefficients(0);
+    computeBandActivity(fPending);
+    fPending.rampFrames = (uint32_t)(kRampTime * fPending.sampleRate);
+    fPending.gateHoldFrames = (uint32_t)(kGateHoldTime * fPending.sampleRate);
+    fPending.autoWindowFrames = (uint32_t)(kAutoWindowTime * fPending.sampleRate);
+    fPending.autoHoldFrames = (uint32_t)(kAutoHoldTime * fPending.sampleRate);
+    fPending.aliasBudget = std::pow(10.0f, 0.1f * fAliasBudget);
+    fPending.loadHoldFrames = (uint32_t)(kLoadHoldTime * fPending.sampleRate);
+    fPending.loadRecoveryFrames = (uint32_t)(kLoadRecoveryTime * fPending.sampleRate);
+    computeOversamplingIndex(fPending);
+    fAuto.index = fAuto.holdIndex = fPending.oversamplingIndex;
+    for (unsigned b = 0; b < Bands; ++b)
+        fAuto.bandShare[b] = 1;
+    for (unsigned index = 0; index < OversamplingValues.size(); ++index) {
+        int over = OversamplingValues[index].first;
+        int lower = (index > 0) ? OversamplingValues[index - 1].first : 0;
+        fLoadLimit.relativeCost[index] = isOversamplingRatio(lower) ? float(over) / lower : 1;
+    }
+    for (unsigned index = 0; index < OversamplingValues.size(); ++index) {
+        switch (OversamplingValues[index].first) {
+        case 2:
+            fStopbandGain[index] = stopbandGain(downsamplerState(fOver2x), 2);
+            break;
+        case 4:
+            fStopbandGain[index] = stopbandGain(downsamplerState(fOver4x), 4);
+            break;
+        case 8:
+            fStopbandGain[index] = stopbandGain(downsamplerState(fOver8x), 8);
+            break;
+        case 16:
+            fStopbandGain[index] = stopbandGain(downsamplerState(fOver16x), 16);
+            break;
+        }
+    }
+    computeBandFilters(fPending);
+    computeTransition(fPending);
+    fSnapshot.reset(fPending);
+
+    fResources = createResources(fBlockSize, fChunkSize, false);
+    fChunkFrames = fResources->chunkFrames;
+    fScratch = fResources->scratch;
+    fCabinet = new Cabinet;
+}
+
+template <unsigned NBands>
+QuadrafuzzEngine<NBands>::~QuadrafuzzEngine()
+{
+    QuadrafuzzWorker::get().cancel(this);
+    if (fPipeline)
+        fPipeline->wait();
+
+    delete fNextResources.exchange(nullptr, std::memory_order_acquire);
+    for (Resources *resources; fRetired.pop(resources);)
+        delete resources;
+    delete fResources;
+
+    delete fNextCabinet.exchange(nullptr, std::memory_order_acquire);
+    for (Cabinet *cabinet; fRetiredCabinets.pop(cabinet);)
+        delete cabinet;
+    delete fFadingCabinet;
+    delete fCabinet;
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::setSampleRate(double sampleRate)
+{
+    if (sampleRate == fPending.sampleRate)
+        return;
+
+    fSampleRate = sampleRate;
+    fPending.sampleRate = sampleRate;
+    fPending.rampFrames = (uint32_t)(kRampTime * sampleRate);
+    fPending.gateHoldFrames = (uint32_t)(kGateHoldTime * sampleRate);
+    fPending.autoWindowFrames = (uint32_t)(kAutoWindowTime * sampleRate);
+    fPending.autoHoldFrames = (uint32_t)(kAutoHoldTime * sampleRate);
+    fPending.loadHoldFrames = (uint32_t)(kLoadHoldTime * sampleRate);
+    fPending.loadRecoveryFrames = (uint32_t)(kLoadRecoveryTime * sampleRate);
+    computeOversamplingIndex(fPending);
+    computeBandFilters(fPending);
+    computeTransition(fPending);
+    publishSnapshot();
+
+    // the impulse response, if any, for the new rate
+    QuadrafuzzWorker::get().post(this, [this, sampleRate]() {
+        if (!fImpulse.empty())
+            updateCabinet(sampleRate);
+    });
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::setBlockSize(uint32_t maxFrames)
+{
+    if (maxFrames == fBlockSize)
+        return;
+
+    fBlockSize = maxFrames;
+    requestResources();
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::setChunkSize(uint32_t frames)
+{
+    if (frames == fChunkSize)
+        return;
+
+    fChunkSize = frames;
+    requestResources();
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::setPipelined(bool pipelined)
+{
+    if (pipelined == fPipelined)
+        return;
+
+    fPipelined = pipelined;
+    requestResources();
+}
+
+template <unsigned NBands>
+auto QuadrafuzzEngine<NBands>::createResources(uint32_t blockSize, uint32_t chunkSize, bool pipelined) -> Resources *
+{
+    uint32_t chunkFrames = blockSize;
+    if (chunkSize > 0 && chunkSize < chunkFrames)
+        chunkFrames = chunkSize;
+    chunkFrames = std::max<uint32_t>(1, chunkFrames);
+
+    std::unique_ptr<Resources> resources(new Resources);
+
+    // keep every array on a boundary of 64 bytes
+    uint32_t stride = (chunkFrames + 15) & ~15u;
+    uint32_t overStride = kMaxOversampling * stride;
+    uint32_t bandOutputs = (Bands % BiquadGroup::Lanes) ? (Bands + 1) : Bands;
+    uint32_t chunkMemory = 3 * stride + (1 + bandOutputs) * overStride;
+    uint32_t pipelineMemory = pipelined ? (2 * chunkMemory + 2 * stride) : 0;
+    resources->memory.resize(6 * stride + (1 + bandOutputs) * overStride + pipelineMemory);
+
+    float *data = resources->memory.data();
+    Scratch &scratch = resources->scratch;
+    scratch.inputGain = data;
+    scratch.dryGain = data + stride;
+    scratch.wetGain = data + 2 * stride;
+    scratch.outputGain = data + 3 * stride;
+    scratch.wet = data + 4 * stride;
+    scratch.targetOutput = data + 5 * stride;
+    scratch.bandIn = data + 6 * stride;
+    for (unsigned b = 0; b < BandLanes; ++b)
+        scratch.bandOut[b] = data + 6 * stride + (1 + std::min(b, bandOutputs - 1)) * overStride;
+
+    // the two chunks of the pipeline, which alternate between the stages,
+    // and the delay of its output
+    if (pipelined) {
+        float *chunkData = data + 6 * stride + (1 + bandOutputs) * overStride;
+        for (PipelineChunk &chunk : resources->chunks) {
+            chunk.wet = chunkData;
+            chunk.dry = chunkData + stride;
+            chunk.mix.outputGainRamp = chunkData + 2 * stride;
+            chunk.stage.bandIn = chunkData + 3 * stride;
+            for (unsigned b = 0; b < BandLanes; ++b)
+                chunk.stage.bandOut[b] = chunkData + 3 * stride + (1 + std::min(b, bandOutputs - 1)) * overStride;
+            chunkData += chunkMemory;
+        }
+        resources->delay = chunkData;
+        resources->pipeline.reset(new QuadrafuzzPipeline);
+    }
+
+    resources->chunkFrames = chunkFrames;
+    return resources.release();
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::requestResources()
+{
+    uint32_t blockSize = fBlockSize;
+    uint32_t chunkSize = fChunkSize;
+    bool pipelined = fPipelined;
+    QuadrafuzzWorker::get().post(this, [this, blockSize, chunkSize, pipelined]() {
+        // without memory, or without a helper thread, the current resources
+        // keep working, in more chunks
+        Resources *resources = nullptr;
+        try {
+            resources = createResources(blockSize, chunkSize, pipelined);
+        }
+        catch (const std::bad_alloc &) {
+            return;
+        }
+        catch (const std::system_error &) {
+            return;
+        }
+        installResources(resources);
+    });
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::installResources(Resources *resources)
+{
+    reclaimResources();
+
+    // resources which `run` did not adopt in time are never used
+    if (Resources *stale = fNextResources.exchange(resources, std::memory_order_acq_rel))
+        delete stale;
+    else
+        ++fUnreclaimed;
+
+    if (!fReclaimScheduled) {
+        fReclaimScheduled = true;
+        scheduleReclaim();
+    }
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::loadImpulseResponse(const char *path)
+{
+    std::string file = path ? path : "";
+    double sampleRate = fSampleRate;
+    QuadrafuzzWorker::get().post(this, [this, file, sampleRate]() {
+        // a file which cannot be read, or without the memory for it, keeps
+        // the current response
+        std::vector<float> samples;
+        double rate = 0;
+        try {
+            if (!file.empty() && !readImpulseResponse(file.c_str(), samples, rate))
+                return;
+        }
+        catch (const std::bad_alloc &) {
+            return;
+        }
+        fImpulse.swap(samples);
+        fImpulseRate = rate;
+        updateCabinet(sampleRate);
+    });
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::setImpulseResponse(const float *samples, uint32_t length, double sampleRate)
+{
+    std::vector<float> response(samples, samples + length);
+    double hostRate = fSampleRate;
+    QuadrafuzzWorker::get().post(this, [this, response, sampleRate, hostRate]() {
+        fImpulse = response;
+        fImpulseRate = sampleRate;
+        updateCabinet(hostRate);
+    });
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::updateCabinet(double sampleRate)
+{
+    // without memory, the current cabinet stays
+    std::unique_ptr<Cabinet> cabinet(new Cabinet);
+    try {
+        std::vector<float> response;
+        if (!fImpulse.empty())
+            resampleImpulseResponse(fImpulse, fImpulseRate, response, sampleRate, (uint32_t)(kMaxImpulseTime * sampleRate));
+        if (!response.empty())
+            cabinet->convolver.reset(new QuadrafuzzConvolver(*fKernels, response.data(), response.size()));
+    }
+    catch (const std::bad_alloc &) {
+        return;
+    }
+    installCabinet(cabinet.release());
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::installCabinet(Cabinet *cabinet)
+{
+    reclaimResources();
+
+    // a cabinet which `run` did not adopt in time is never used
+    if (Cabinet *stale = fNextCabinet.exchange(cabinet, std::memory_order_acq_rel))
+        delete stale;
+    else
+        ++fUnreclaimed;
+
+    if (!fReclaimScheduled) {
+        fReclaimScheduled = true;
+        scheduleReclaim();
+    }
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::scheduleReclaim()
+{
+    // look again later, until `run` replaced all of them, or until it
+    // replaced none since the last look, as an instance which does not run
+    auto interval = std::chrono::duration_cast<QuadrafuzzWorker::Clock::duration>(
+        std::chrono::duration<double>(kReclaimInterval));
+    QuadrafuzzWorker::get().post(this, [this]() {
+        unsigned unreclaimed = fUnreclaimed;
+        reclaimResources();
+        fReclaimScheduled = fUnreclaimed > 0 && fUnreclaimed < unreclaimed;
+        if (fReclaimScheduled)
+            scheduleReclaim();
+    }, interval);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::reclaimResources()
+{
+    for (Resources *resources; fRetired.pop(resources);) {
+        delete resources;
+        --fUnreclaimed;
+    }
+    for (Cabinet *cabinet; fRetiredCabinets.pop(cabinet);) {
+        delete cabinet;
+        --fUnreclaimed;
+    }
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::adoptResources()
+{
+    if (!fNextResources.load(std::memory_order_relaxed))
+        return;
+
+    // the ring has room for the resources which are replaced, unless the
+    // worker is late to free them, and then it waits for a later block
+    if (fRetired.size() == kRetiredCapacity)
+        return;
+
+    Resources *resources = fNextResources.exchange(nullptr, std::memory_order_acq_rel);
+    if (!resources)
+        return;
+
+    // the chunk in the pipeline completes in the old memory, and the delay
+    // keeps its content, cut or padded at the front to the new latency
+    drainPipeline(fSnapshot.getReadBuffer());
+    uint32_t latency = resources->pipeline ? resources->chunkFrames : 0;
+    if (resources->pipeline) {
+        uint32_t kept = std::min(fDelayFill, latency);
+        std::fill(resources->delay, resources->delay + latency - kept, 0.0f);
+        std::memcpy(resources->delay + latency - kept, fDelay + fDelayFill - kept, kept * sizeof(float));
+        for (PipelineChunk &chunk : resources->chunks)
+            chunk.engine = this;
+    }
+
+    fRetired.push(fResources);
+    fResources = resources;
+    fChunkFrames = resources->chunkFrames;
+    fScratch = resources->scratch;
+    fPipeline = resources->pipeline.get();
+    fPipelineChunks = resources->chunks;
+    fNextPipelineChunk = 0;
+    fDelay = resources->delay;
+    fDelayFill = latency;
+    fLatency.store(latency, std::memory_order_relaxed);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::adoptCabinet()
+{
+    // one change at a time, and the ring has room for the cabinet which
+    // fades out, as for the resources
+    if (fFadingCabinet || !fNextCabinet.load(std::memory_order_relaxed))
+        return;
+    if (fRetiredCabinets.size() == kRetiredCapacity)
+        return;
+
+    Cabinet *cabinet = fNextCabinet.exchange(nullptr, std::memory_order_acq_rel);
+    if (!cabinet)
+        return;
+    fFadingCabinet = fCabinet;
+    fCabinet = cabinet;
+    fCabinetFadeFrame = 0;
+    fCabinetFadeCos = 1;
+    fCabinetFadeSin = 0;
+    fImpulseLength.store(cabinet->convolver ? cabinet->convolver->getLength() : 0, std::memory_order_relaxed);
+}
+
+template <unsigned NBands>
+float QuadrafuzzEngine<NBands>::getParameterValue(uint32_t index) const
+{
+    if (index >= pIdDrive && index < pIdDrive + Bands)
+        return fDrive[index - pIdDrive];
+    if (index >= ParameterMute && index < ParameterMute + Bands)
+        return fMute[index - ParameterMute];
+    if (index >= ParameterSolo && index < ParameterSolo + Bands)
+        return fSolo[index - ParameterSolo];
+    if (index >= ParameterActivity && index < ParameterActivity + Bands)
+        return (fBandActivity.load(std::memory_order_relaxed) >> (index - ParameterActivity)) & 1;
+
+    switch (index) {
+    case pIdBypass:
+        return fBypass;
+    case pIdInputGain:
+        return fInputGain;
+    case pIdOutputGain:
+        return fOutputGain;
+    case pIdDryGain:
+        return fDryGain;
+    case pIdWetGain:
+        return fWetGain;
+    case ParameterOversampling:
+        return fOversampling;
+    case ParameterDspLoad:
+        return std::min(fTelemetry.getLoad(), 100.0f);
+    case ParameterDspLoadPeak:
+        return std::min(fTelemetry.getPeakLoad(), 100.0f);
+    case ParameterAliasBudget:
+        return fAliasBudget;
+    case ParameterCpuBudget:
+        return fCpuBudget;
+    case ParameterEffectiveOversampling:
+        return fEffectiveOversampling.load(std::memory_order_relaxed);
+    default:
+        assert(false);
+        return 0;
+    }
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::setParameterValue(uint32_t index, float value)
+{
+    Snapshot &p = fPending;
+
+    if (index >= pIdDrive && index < pIdDrive + Bands) {
+        unsigned band = index - pIdDrive;
+        fDrive[band] = value;
+        p.shaper[band] = shaperCoefficients(value);
+        publishSnapshot();
+        return;
+    }
+    if (index >= ParameterMute && index < ParameterMute + Bands) {
+        fMute[index - ParameterMute] = value > 0.5f;
+        computeBandActivity(p);
+        publishSnapshot();
+        return;
+    }
+    if (index >= ParameterSolo && index < ParameterSolo + Bands) {
+        fSolo[index - ParameterSolo] = value > 0.5f;
+        computeBandActivity(p);
+        publishSnapshot();
+        return;
+    }
+    if (index >= ParameterActivity && index < ParameterActivity + Bands)
+        return;
+
+    switch (index) {
+    case pIdBypass:
+        fBypass = value > 0.5f;
+        p.bypass = fBypass;
+        break;
+    case pIdInputGain:
+        fInputGain = value;
+        p.gainDb[GainInput] = value;
+        p.gain[GainInput] = std::pow(10.0f, 0.05f * value);
+        break;
+    case pIdOutputGain:
+        fOutputGain = value;
+        p.gainDb[GainOutput] = value;
+        p.gain[GainOutput] = std::pow(10.0f, 0.05f * value);
+        break;
+    case pIdDryGain:
+        fDryGain = value;
+        p.gainDb[GainDry] = value;
+        p.gain[GainDry] = std::pow(10.0f, 0.05f * value);
+        break;
+    case pIdWetGain:
+        fWetGain = value;
+        p.gainDb[GainWet] = value;
+        p.gain[GainWet] = std::pow(10.0f, 0.05f * value);
+        break;
+    case ParameterOversampling:
+    {
+        unsigned index = OversamplingValues.size() - 1;
+        while (index > 0 && value < OversamplingValues[index].first)
+            --index;
+        fOversampling = OversamplingValues[index].first;
+        p.oversampling = fOversampling;
+        computeOversamplingIndex(p);
+        break;
+    }
+    case ParameterAliasBudget:
+        fAliasBudget = value;
+        p.aliasBudget = std::pow(10.0f, 0.1f * value);
+        break;
+    case ParameterCpuBudget:
+        fCpuBudget = value;
+        p.cpuBudget = value;
+        break;
+    case ParameterDspLoad:
+    case ParameterDspLoadPeak:
+    case ParameterEffectiveOversampling:
+        return;
+    default:
+        assert(false);
+        return;
+    }
+
+    publishSnapshot();
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::publishSnapshot()
+{
+    fSnapshot.getWriteBuffer() = fPending;
+    fSnapshot.publish();
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::run(const float *input, float *output, uint32_t frames)
+{
+    fTelemetry.beginBlock();
+
+    adoptResources();
+    adoptCabinet();
+
+    if (fSnapshot.update() || !fRampsInitialized) {
+        setupRamps(fSnapshot.getReadBuffer(), !fRampsInitialized);
+        fRampsInitialized = true;
+    }
+    const Snapshot &p = fSnapshot.getReadBuffer();
+
+    if (p.bypass) {
+        if (fPipeline) {
+            for (uint32_t i = 0; i < frames; i += fChunkFrames)
+                runDelayedChunk(p, input + i, output + i, std::min(frames - i, fChunkFrames));
+        }
+        else if (output != input)
+            memcpy(output, input, frames * sizeof(float));
+    }
+    else {
+        unsigned index = p.oversamplingIndex;
+        if (p.oversampling == OversamplingAuto)
+            index = chooseOversampling(p, input, frames);
+        else
+            fAuto.index = index;
+        if (isOffline())
+            index = OversamplingValues.size() - 1;
+        index = std::min(index, fLoadLimit.cap);
+
+        // the chunk in the pipeline completes before the paths change
+        if (fActiveFilterSerial != p.filterSerial) {
+            drainPipeline(p);
+            setupFilters(p, index);
+        }
+        else if (!fTransition && fPath[fActivePath].oversampling != (unsigned)OversamplingValues[index].first) {
+            drainPipeline(p);
+            beginTransition(p, index);
+        }
+
+        for (uint32_t i = 0; i < frames; i += fChunkFrames) {
+            uint32_t framesCurrent = std::min(frames - i, fChunkFrames);
+            if (fPipeline)
+                runDelayedChunk(p, input + i, output + i, framesCurrent);
+            else
+                runChunk(p, input + i, output + i, framesCurrent);
+        }
+    }
+
+    fBandActivity.store(fBlockActivity, std::memory_order_relaxed);
+    fBlockActivity = 0;
+    if (!p.bypass)
+        fEffectiveOversampling.store(fPath[fActivePath].oversampling, std::memory_order_relaxed);
+
+    // a bypassed block counts for the ratio which resumes, and not for the
+    // mode, which is not a ratio in `auto` and `352.8k`
+    fTelemetry.endBlock(frames, fPath[fActivePath].oversampling, p.bypass, p.sampleRate);
+    updateLoadLimit(p, frames);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::runChunk(const Snapshot &p, const float *input, float *output, uint32_t frames)
+{
+    ChunkMix mix;
+    mix.outputGainRamp = fScratch.outputGain;
+    float *wet = fScratch.wet;
+    beginChunk(mix, input, wet, output, frames);
+
+    if (!fTransition)
+        runPath(p, fPath[fActivePath], wet, wet, frames);
+    else
+        runTransition(p, wet, wet, frames);
+
+    endChunk(p, mix, wet, output, frames);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::beginChunk(ChunkMix &mix, const float *input, float *wet, float *dry, uint32_t frames)
+{
+    const QuadrafuzzKernels &k = *fKernels;
+
+    // compute the gains, as ramps if they are changing
+    bool gainRamp = false;
+    for (unsigned g = 0; g < GainCount; ++g)
+        gainRamp = gainRamp || fGainRamp[g].isRamping();
+
+    float dryGain = fGainRamp[GainInput].getLinear() * fGainRamp[GainDry].getLinear();
+    float wetGain = fGainRamp[GainInput].getLinear() * fGainRamp[GainWet].getLinear();
+    mix.gainRamp = gainRamp;
+    mix.outputGain = fGainRamp[GainOutput].getLinear();
+
+    float *dryGainRamp = fScratch.dryGain;
+    float *wetGainRamp = fScratch.wetGain;
+    if (gainRamp) {
+        float *inputGainRamp = fScratch.inputGain;
+        fGainRamp[GainInput].generate(inputGainRamp, frames);
+        fGainRamp[GainDry].generate(dryGainRamp, frames);
+        fGainRamp[GainWet].generate(wetGainRamp, frames);
+        fGainRamp[GainOutput].generate(mix.outputGainRamp, frames);
+        k.scaleRamp(dryGainRamp, dryGainRamp, inputGainRamp, frames);
+        k.scaleRamp(wetGainRamp, wetGainRamp, inputGainRamp, frames);
+    }
+
+    // compute wet signal, before the output can overwrite the input
+    if (gainRamp)
+        k.scaleRamp(wet, input, wetGainRamp, frames);
+    else
+        k.scale(wet, input, wetGain, frames);
+
+    // add dry signal
+    if (gainRamp)
+        k.scaleRamp(dry, input, dryGainRamp, frames);
+    else
+        k.scale(dry, input, dryGain, frames);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::endChunk(const Snapshot &p, const ChunkMix &mix, float *wet, float *output, uint32_t frames)
+{
+    const QuadrafuzzKernels &k = *fKernels;
+
+    if (mix.gainRamp)
+        k.multiplyAddRamp(output, wet, mix.outputGainRamp, frames);
+    else
+        k.multiplyAdd(output, wet, mix.outputGain, frames);
+
+    // the cabinet is at the end of the chain, so it colors the dry signal
+    // like the wet one, and a blend does not comb between the two
+    runCabinet(p, output, frames);
+
+    advanceShaperRamps(frames);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::runDelayedChunk(const Snapshot &p, const float *input, float *output, uint32_t frames)
+{
+    // a transition runs both paths on the audio thread, and a bypass the
+    // input, through the same delay, and so does everything if the helper
+    // could not take the priority of the audio thread
+    if (!p.bypass && !fTransition && !fPipeline->isLowerPriority())
+        runPipelinedChunk(p, input, frames);
+    else {
+        drainPipeline(p);
+        float *delayed = &fDelay[fDelayFill];
+        if (p.bypass)
+            std::memcpy(delayed, input, frames * sizeof(float));
+        else
+            runChunk(p, input, delayed, frames);
+        fDelayFill += frames;
+    }
+
+    // the output is the latency behind, which is a chunk, and the delay
+    // holds at most two
+    std::memcpy(output, fDelay, frames * sizeof(float));
+    fDelayFill -= frames;
+    std::memmove(fDelay, fDelay + frames, fDelayFill * sizeof(float));
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::runPipelinedChunk(const Snapshot &p, const float *input, uint32_t frames)
+{
+    PipelineChunk &chunk = fPipelineChunks[fNextPipelineChunk];
+    fNextPipelineChunk ^= 1;
+    chunk.stage.frames = frames;
+    beginChunk(chunk.mix, input, chunk.wet, chunk.dry, frames);
+
+    // the helper is done with the previous chunk, and takes this one
+    fPipeline->wait();
+    Path &path = fPath[fActivePath];
+    chunk.path = &path;
+    runPathStep(kPlanStep, &p, path, chunk.stage, chunk.wet, nullptr);
+    fPipeline->post(&runPipelineJob, &chunk);
+
+    // meanwhile, the previous chunk goes through the shaper
+    finishPipelinedChunk(p);
+    fPendingChunk = &chunk;
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::runPipelineJob(void *data)
+{
+    PipelineChunk &chunk = *(PipelineChunk *)data;
+    chunk.engine->runPathStep(kFilterStep, nullptr, *chunk.path, chunk.stage, nullptr, nullptr);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::finishPipelinedChunk(const Snapshot &p)
+{
+    PipelineChunk *chunk = fPendingChunk;
+    if (!chunk)
+        return;
+    fPendingChunk = nullptr;
+
+    uint32_t frames = chunk->stage.frames;
+    runPathStep(kFinishStep, &p, *chunk->path, chunk->stage, nullptr, chunk->wet);
+    float *output = &fDelay[fDelayFill];
+    std::memcpy(output, chunk->dry, frames * sizeof(float));
+    endChunk(p, chunk->mix, chunk->wet, output, frames);
+    fDelayFill += frames;
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::drainPipeline(const Snapshot &p)
+{
+    if (!fPendingChunk)
+        return;
+    fPipeline->wait();
+    finishPipelinedChunk(p);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::runTransition(const Snapshot &p, const float *input, float *output, uint32_t frames)
+{
+    Path &target = fPath[fActivePath ^ 1];
+    float *targetOutput = fScratch.targetOutput;
+    runPath(p, target, input, targetOutput, frames);
+    runPath(p, fPath[fActivePath], input, output, frames);
+
+    uint32_t warmUpEnd = p.warmUpFrames;
+    uint32_t crossfadeEnd = p.warmUpFrames + p.crossfadeFrames;
+
+    // after the warm-up, crossfade with equal power, rotating (cos, sin)
+    float c = fCrossfadeCos;
+    float s = fCrossfadeSin;
+    for (uint32_t i = 0; i < frames; ++i) {
+        uint32_t t = fTransitionFrame + i;
+        if (t < warmUpEnd)
+            continue;
+        if (t < crossfadeEnd) {
+            output[i] = c * output[i] + s * targetOutput[i];
+            float r = c * p.crossfadeCos - s * p.crossfadeSin;
+            s = s * p.crossfadeCos + c * p.crossfadeSin;
+            c = r;
+        }
+        else
+            output[i] = targetOutput[i];
+    }
+    fCrossfadeCos = c;
+    fCrossfadeSin = s;
+
+    fTransitionFrame += frames;
+    if (fTransitionFrame >= crossfadeEnd) {
+        fActivePath ^= 1;
+        fTransition = false;
+    }
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::runCabinet(const Snapshot &p, float *inout, uint32_t frames)
+{
+    QuadrafuzzConvolver *convolver = fCabinet->convolver.get();
+    Cabinet *fading = fFadingCabinet;
+    if (!fading) {
+        if (convolver)
+            convolver->process(inout, inout, frames);
+        return;
+    }
+
+    // the output of the transition was mixed, so its memory is free
+    float *fadingOutput = fScratch.targetOutput;
+    if (fading->convolver)
+        fading->convolver->process(inout, fadingOutput, frames);
+    else
+        memcpy(fadingOutput, inout, frames * sizeof(float));
+    if (convolver)
+        convolver->process(inout, inout, frames);
+
+    // crossfade with equal power, rotating (cos, sin)
+    float c = fCabinetFadeCos;
+    float s = fCabinetFadeSin;
+    uint32_t count = std::min(frames, p.crossfadeFrames - std::min(fCabinetFadeFrame, p.crossfadeFrames));
+    for (uint32_t i = 0; i < count; ++i) {
+        inout[i] = c * fadingOutput[i] + s * inout[i];
+        float r = c * p.crossfadeCos - s * p.crossfadeSin;
+        s = s * p.crossfadeCos + c * p.crossfadeSin;
+        c = r;
+    }
+    fCabinetFadeCos = c;
+    fCabinetFadeSin = s;
+
+    fCabinetFadeFrame += frames;
+    if (fCabinetFadeFrame >= p.crossfadeFrames) {
+        fRetiredCabinets.push(fading);
+        fFadingCabinet = nullptr;
+    }
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::runPath(const Snapshot &p, Path &path, const float *input, float *output, uint32_t frames)
+{
+    switch (path.oversampling) {
+    default:
+        assert(false);
+        /* fall through */
+    case 1:
+    {
+        DSP::NoOversampler os;
+        runPathWithOversampler(p, os, path, input, output, frames);
+        break;
+    }
+    case 2:
+        runPathWithOversampler(p, fOver2x, path, input, output, frames);
+        break;
+    case 4:
+        runPathWithOversampler(p, fOver4x, path, input, output, frames);
+        break;
+    case 8:
+        runPathWithOversampler(p, fOver8x, path, input, output, frames);
+        break;
+    case 16:
+        runPathWithOversampler(p, fOver16x, path, input, output, frames);
+        break;
+    }
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::runPathStep(PathStep step, const Snapshot *p, Path &path, Stage &stage, const float *input, float *output)
+{
+    switch (path.oversampling) {
+    default:
+        assert(false);
+        /* fall through */
+    case 1:
+    {
+        DSP::NoOversampler os;
+        runPathStepWithOversampler(step, p, os, path, stage, input, output);
+        break;
+    }
+    case 2:
+        runPathStepWithOversampler(step, p, fOver2x, path, stage, input, output);
+        break;
+    case 4:
+        runPathStepWithOversampler(step, p, fOver4x, path, stage, input, output);
+        break;
+    case 8:
+        runPathStepWithOversampler(step, p, fOver8x, path, stage, input, output);
+        break;
+    case 16:
+        runPathStepWithOversampler(step, p, fOver16x, path, stage, input, output);
+        break;
+    }
+}
+
+template <unsigned NBands>
+template <class Oversampler>
+void QuadrafuzzEngine<NBands>::runPathStepWithOversampler(PathStep step, const Snapshot *p, Oversampler &os, Path &path, Stage &stage, const float *input, float *output)
+{
+    switch (step) {
+    case kPlanStep:
+        planStage(*p, os, path, stage, input);
+        break;
+    case kFilterStep:
+        upsampleStage(os, stage);
+        filterStage(path, stage);
+        break;
+    case kFinishStep: {
+        uint64_t t = fTelemetry.stageBegin();
+        finishStage(*p, os, path, stage, output, t);
+        break;
+    }
+    }
+}
+
+/* writes the inputs into the history of a FIR filter, as processing would */
+static void pushHistory(const QuadrafuzzKernels::FirState &fir, const float *input, uint32_t frames)
+{
+    if (!fir.x)
+        return;
+
+    uint32_t h = *fir.h;
+    for (uint32_t i = 0; i < frames; ++i) {
+        fir.x[h] = input[i];
+        h = (h + 1) & fir.mask;
+    }
+    *fir.h = h;
+}
+
+template <unsigned NBands>
+template <class Oversampler>
+void QuadrafuzzEngine<NBands>::runPathWithOversampler(const Snapshot &p, Oversampler &os, Path &path, const float *input, float *output, uint32_t frames)
+{
+    static_assert(Oversampler::Ratio <= kMaxOversampling, "the scratch memory is too small");
+
+    uint64_t t = fTelemetry.stageBegin();
+
+    Stage stage;
+    stage.frames = frames;
+    stage.bandIn = fScratch.bandIn;
+    for (unsigned b = 0; b < BandLanes; ++b)
+        stage.bandOut[b] = fScratch.bandOut[b];
+
+    planStage(p, os, path, stage, input);
+    upsampleStage(os, stage);
+    if (stage.silent) {
+        std::memset(output, 0, frames * sizeof(float));
+        return;
+    }
+    fTelemetry.stageEnd(TelemetryRecord::kStageUpsample, t);
+
+    filterStage(path, stage);
+    fTelemetry.stageEnd(TelemetryRecord::kStageFilters, t);
+
+    finishStage(p, os, path, stage, output, t);
+}
+
+template <unsigned NBands>
+template <class Oversampler>
+void QuadrafuzzEngine<NBands>::planStage(const Snapshot &p, Oversampler &os, Path &path, Stage &stage, const float *input)
+{
+    constexpr uint32_t over = Oversampler::Ratio;
+    const QuadrafuzzKernels &k = *fKernels;
+
+    // find the bands which are heard, and the groups which have one;
+    // while the input is quiet, the groups of gated bands skip the filters
+    uint32_t frames = stage.frames;
+    uint32_t overFrames = over * frames;
+    float inputEnergy = k.sumSquares(input, frames) * over;
+    stage.input = input;
+    stage.inputEnergy = inputEnergy;
+    stage.measure = p.oversampling == OversamplingAuto;
+
+    unsigned groupCount = 0;
+    for (unsigned g = 0; g < BandGroups; ++g)
+        stage.groupActive[g] = false;
+    for (unsigned b = 0; b < Bands; ++b) {
+        stage.heard[b] = !isBandSilent(b);
+        stage.quietEnergy[b] = stage.heard[b] ? gateEnergy(b, overFrames) : 0.0f;
+        bool gated = path.quietFrames[b] >= p.gateHoldFrames;
+        if (stage.heard[b] && !(gated && inputEnergy < stage.quietEnergy[b]))
+            stage.groupActive[b / BiquadGroup::Lanes] = true;
+    }
+    for (unsigned g = 0; g < BandGroups; ++g)
+        groupCount += stage.groupActive[g];
+
+    // without any group, once the downsampler has only zeros in its history,
+    // the output is silent, and only the upsampler keeps its history
+    stage.silent = groupCount == 0 && path.silentFrames >= downsamplerState(os).taps;
+    stage.groupCount = groupCount;
+
+    // a group which resumes starts from a clear state; the count of silent
+    // frames starts over with a chunk which may be heard, before it is known
+    // whether it is, since a chunk in the pipeline is planned before the
+    // previous one has gone through the shaper
+    for (unsigned g = 0; g < BandGroups; ++g) {
+        stage.groupReset[g] = !stage.silent && stage.groupActive[g] && path.groupIdle[g];
+        path.groupIdle[g] = stage.silent || !stage.groupActive[g];
+    }
+    if (groupCount > 0)
+        path.silentFrames = 0;
+}
+
+template <unsigned NBands>
+template <class Oversampler>
+void QuadrafuzzEngine<NBands>::upsampleStage(Oversampler &os, Stage &stage)
+{
+    constexpr uint32_t over = Oversampler::Ratio;
+    const QuadrafuzzKernels &k = *fKernels;
+    uint32_t frames = stage.frames;
+
+    if (stage.silent) {
+        pushHistory(upsamplerState(os), stage.input, frames);
+        return;
+    }
+
+    // compute oversampled input, which is the input itself without oversampling
+    if (over > 1)
+        upsample(k, os, stage.input, stage.bandIn, frames);
+
+    // the automatic oversampling measures the bands against what the
+    // upsampler passes, for the spectrum of the input alone
+    if (stage.measure && over > 1)
+        stage.inputEnergy = k.sumSquares(stage.bandIn, over * frames);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::filterStage(Path &path, Stage &stage)
+{
+    if (stage.silent)
+        return;
+
+    const QuadrafuzzKernels &k = *fKernels;
+    uint32_t overFrames = path.oversampling * stage.frames;
+    const float *bandIn = (path.oversampling > 1) ? stage.bandIn : stage.input;
+
+    // compute oversampled output
+    float *const *bandOut = stage.bandOut;
+    for (unsigned g = 0; g < BandGroups; ++g) {
+        BiquadGroup &group = path.filters[g];
+        if (stage.groupReset[g]) {
+            for (unsigned l = 0; l < BiquadGroup::Lanes; ++l)
+                group.x1[l] = group.x2[l] = group.y1[l] = group.y2[l] = 0;
+        }
+    }
+    if (stage.groupCount == BandGroups)
+        k.biquadGroups(path.filters, BandGroups, bandIn, bandOut, overFrames);
+    else {
+        for (unsigned g = 0; g < BandGroups; ++g) {
+            if (stage.groupActive[g])
+                k.biquadGroups(&path.filters[g], 1, bandIn, &bandOut[g * BiquadGroup::Lanes], overFrames);
+        }
+    }
+}
+
+template <unsigned NBands>
+template <class Oversampler>
+void QuadrafuzzEngine<NBands>::finishStage(const Snapshot &p, Oversampler &os, Path &path, Stage &stage, float *output, uint64_t &t)
+{
+    constexpr uint32_t over = Oversampler::Ratio;
+    const QuadrafuzzKernels &k = *fKernels;
+    uint32_t frames = stage.frames;
+    uint32_t overFrames = over * frames;
+
+    if (stage.silent) {
+        std::memset(output, 0, frames * sizeof(float));
+        return;
+    }
+    if (stage.measure)
+        path.inputEnergy += stage.inputEnergy;
+
+    // gate the bands which stayed quiet, and shape the others; the bands
+    // of the groups which skipped the filters count as quiet
+    float *const *bandOut = stage.bandOut;
+    const float *activeOut[Bands];
+    unsigned activeCount = 0;
+    for (unsigned b = 0; b < Bands; ++b) {
+        if (!stage.heard[b])
+            continue;
+        bool filtered = stage.groupActive[b / BiquadGroup::Lanes];
+        float energy = filtered ? k.sumSquares(bandOut[b], overFrames) : 0.0f;
+        path.bandEnergy[b] += energy;
+        bool quiet = energy < stage.quietEnergy[b];
+        if (!quiet)
+            path.quietFrames[b] = 0;
+        else if (path.quietFrames[b] < p.gateHoldFrames)
+            path.quietFrames[b] += frames;
+        if (path.quietFrames[b] >= p.gateHoldFrames || !filtered)
+            continue;
+        distortBand(b, bandOut[b], over, frames);
+        activeOut[activeCount++] = bandOut[b];
+        fBlockActivity |= 1u << b;
+    }
+    fTelemetry.stageEnd(TelemetryRecord::kStageShaper, t);
+
+    // mix the bands, in the place of the oversampled input which is unused
+    float *mix = (over > 1) ? stage.bandIn : output;
+    if (activeCount > 0) {
+        k.sum(mix, activeOut, activeCount, overFrames);
+        path.silentFrames = 0;
+    }
+    else {
+        std::memset(mix, 0, overFrames * sizeof(float));
+        path.silentFrames = std::min<uint32_t>(path.silentFrames + overFrames, QuadrafuzzKernels::FirState::MaxTaps);
+    }
+    if (over > 1)
+        downsample(k, os, stage.bandIn, output, frames);
+    fTelemetry.stageEnd(TelemetryRecord::kStageDownsample, t);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::setupPath(Path &path, const Snapshot &p, unsigned index)
+{
+    path.oversampling = OversamplingValues[index].first;
+    path.index = index;
+    for (unsigned b = 0; b < BandLanes; ++b) {
+        BiquadGroup &group = path.filters[b / BiquadGroup::Lanes];
+        unsigned lane = b % BiquadGroup::Lanes;
+        const WebCore::Biquad::Coefficients c =
+            (b < Bands) ? p.bandFilter[index][b] : WebCore::Biquad::Coefficients{};
+        group.b0[lane] = c.b0;
+        group.b1[lane] = c.b1;
+        group.b2[lane] = c.b2;
+        group.a1[lane] = c.a1;
+        group.a2[lane] = c.a2;
+        group.x1[lane] = group.x2[lane] = 0;
+        group.y1[lane] = group.y2[lane] = 0;
+    }
+    for (unsigned g = 0; g < BandGroups; ++g)
+        path.groupIdle[g] = false;
+    for (unsigned b = 0; b < Bands; ++b)
+        path.quietFrames[b] = 0;
+    path.silentFrames = 0;
+    path.inputEnergy = 0;
+    for (unsigned b = 0; b < Bands; ++b)
+        path.bandEnergy[b] = 0;
+
+    switch (path.oversampling) {
+    default:
+        assert(false);
+        /* fall through */
+    case 1:
+        break;
+    case 2:
+        fOver2x.reset();
+        break;
+    case 4:
+        fOver4x.reset();
+        break;
+    case 8:
+        fOver8x.reset();
+        break;
+    case 16:
+        fOver16x.reset();
+        break;
+    }
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::setupFilters(const Snapshot &p, unsigned index)
+{
+    setupPath(fPath[fActivePath], p, index);
+    fTransition = false;
+    fActiveFilterSerial = p.filterSerial;
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::beginTransition(const Snapshot &p, unsigned index)
+{
+    setupPath(fPath[fActivePath ^ 1], p, index);
+    fTransition = true;
+    fTransitionFrame = 0;
+    fCrossfadeCos = 1;
+    fCrossfadeSin = 0;
+}
+
+template <unsigned NBands>
+unsigned QuadrafuzzEngine<NBands>::chooseOversampling(const Snapshot &p, const float *input, uint32_t frames)
+{
+    AutoOversampling &a = fAuto;
+
+    // the energy of the input, and of its differences, which tells its frequency
+    float last = a.lastInput;
+    float energy = 0;
+    float differenceEnergy = 0;
+    for (uint32_t i = 0; i < frames; ++i) {
+        float x = input[i];
+        float d = x - last;
+        energy += x * x;
+        differenceEnergy += d * d;
+        last = x;
+    }
+    a.lastInput = last;
+    a.inputEnergy += energy;
+    a.differenceEnergy += differenceEnergy;
+    a.frames += frames;
+    if (a.frames < p.autoWindowFrames)
+        return a.index;
+
+    // the share of each band in the energy of the input, as measured by the
+    // active path, unless the input was too quiet to tell, under -80 dBFS
+    Path &path = fPath[fActivePath];
+    if (path.inputEnergy > 1e-8f * path.oversampling * a.frames) {
+        for (unsigned b = 0; b < Bands; ++b)
+            a.bandShare[b] = std::min(path.bandEnergy[b] / path.inputEnergy, 1.0f);
+    }
+    path.inputEnergy = 0;
+    for (unsigned b = 0; b < Bands; ++b)
+        path.bandEnergy[b] = 0;
+
+    // the mean square of the input of the path, and its frequency, from the
+    // ratio of energies which is 4 sin^2(pi f / fs) for a sine
+    float gain = fGainRamp[GainInput].getLinear() * fGainRamp[GainWet].getLinear();
+    float inputEnergy = gain * gain * a.inputEnergy / a.frames;
+    float ratio = a.differenceEnergy / std::max(a.inputEnergy, 1e-30f);
+    float inputFrequency = p.sampleRate / M_PI * std::asin(std::min(0.5f * std::sqrt(ratio), 1.0f));
+
+    // the lowest ratio which is under the budget, otherwise the one which
+    // comes closest, unless a lower one is within 1 dB; the leak of the
+    // downsamplers makes the highest ratio not always the best; the offline
+    // ratio is never chosen, and the one under it is the default
+    unsigned choice = OversamplingValues.size() - 2;
+    float closest = FLT_MAX;
+    for (unsigned index = 0; index < OversamplingValues.size(); ++index) {
+        int over = OversamplingValues[index].first;
+        if (!isOversamplingRatio(over) || over == OversamplingOffline)
+            continue;
+        float aliasing = estimateAliasing(p, index, inputEnergy, inputFrequency);
+        if (aliasing < p.aliasBudget) {
+            choice = index;
+            break;
+        }
+        if (aliasing < closest) {
+            choice = index;
+            closest = 0.8f * aliasing;
+        }
+    }
+
+    // go up at once, and down to the highest choice of the hold time
+    if (choice >= a.index) {
+        a.index = choice;
+        a.holdFrames = 0;
+    }
+    else {
+        a.holdIndex = (a.holdFrames > 0) ? std::max(a.holdIndex, choice) : choice;
+        a.holdFrames += a.frames;
+        if (a.holdFrames >= p.autoHoldFrames) {
+            a.index = a.holdIndex;
+            a.holdFrames = 0;
+        }
+    }
+
+    a.frames = 0;
+    a.inputEnergy = 0;
+    a.differenceEnergy = 0;
+    return a.index;
+}
+
+template <unsigned NBands>
+float QuadrafuzzEngine<NBands>::estimateAliasing(const Snapshot &p, unsigned index, float inputEnergy, float inputFrequency) const
+{
+    // the harmonics which fold back under the Nyquist frequency; those which
+    // fold between it and the oversampled one are removed by the downsampler,
+    // as far as its stopband goes
+    unsigned over = OversamplingValues[index].first;
+    float nyquist = 0.5f * p.sampleRate;
+    float foldFrequency = (2 * over - 1) * nyquist;
+    float stopbandGain = fStopbandGain[index];
+
+    // the edges of the bandpass filters, at -3 dB
+    const double q = M_SQRT1_2;
+    const float upperEdge = std::sqrt(1 + 0.25 / (q * q)) + 0.5 / q;
+    const float lowerEdge = std::sqrt(1 + 0.25 / (q * q)) - 0.5 / q;
+
+    float energy = 0;
+    for (unsigned b = 0; b < Bands; ++b) {
+        const LinearRamp &gainRamp = fShaperGainRamp[b];
+        const LinearRamp &scaleRamp = fShaperScaleRamp[b];
+        float scale = std::max(scaleRamp.getValue(), scaleRamp.getTarget());
+        if (scale == 0)
+            continue;
+        float gain = std::max(gainRamp.getValue(), gainRamp.getTarget());
+
+        // the content of a band is taken at the frequency of the input,
+        // within the edges of the band
+        float frequency = getBand(b).frequency;
+        float lower = (b == 0) ? 0.0f : (b == Bands - 1) ? frequency : lowerEdge * frequency;
+        float upper = (b == 0) ? frequency : (b == Bands - 1) ? nyquist : upperEdge * frequency;
+        frequency = std::min(std::max(inputFrequency, lower), upper);
+
+        float amplitude = std::sqrt(2 * fAuto.bandShare[b] * inputEnergy);
+        float aliased = fAliasModel->aliasEnergy(amplitude, frequency, foldFrequency, gain, scale);
+        float filtered = fAliasModel->aliasEnergy(amplitude, frequency, nyquist, gain, scale) - aliased;
+        energy += aliased + stopbandGain * std::max(filtered, 0.0f);
+    }
+
+    float outputGain = fGainRamp[GainOutput].getLinear();
+    return outputGain * outputGain * energy;
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::updateLoadLimit(const Snapshot &p, uint32_t frames)
+{
+    LoadLimit &l = fLoadLimit;
+    const unsigned highest = OversamplingValues.size() - 1;
+    unsigned lowest = 0;
+    while (!isOversamplingRatio(OversamplingValues[lowest].first))
+        ++lowest;
+
+    // offline, the load tells whether real time would keep up, and limits
+    // the offline ratio even without a budget
+    float budget = p.cpuBudget;
+    if (budget <= 0 && isOffline())
+        budget = kOfflineLoadBudget;
+    if (budget <= 0) {
+        l.cap = highest;
+        return;
+    }
+
+    // the load is only known once the telemetry is calibrated, and it does
+    // not tell the cost of a ratio during a transition, which runs two
+    float load = fTelemetry.getBlockLoad();
+    if (p.bypass || fTransition || load <= 0)
+        return;
+
+    // a block which was preempted counts for twice the budget at most, so
+    // it takes a sustained overload to step down
+    load = std::min(load, 2 * budget);
+
+    unsigned current = fPath[fActivePath].index;
+    if (current != l.index) {
+        l.previousIndex = l.index;
+        l.previousLoad = l.load;
+        l.index = current;
+        l.load = load;
+        l.holdFrames = 0;
+        l.recoveryFrames = 0;
+        return;
+    }
+
+    float mu = 1 - std::exp(-(float)frames / (kLoadSmoothTime * p.sampleRate));
+    l.load += mu * (load - l.load);
+
+    // once settled after a change by one step, compare the two loads
+    uint32_t holdFrames = l.holdFrames + frames;
+    if (l.holdFrames < p.loadHoldFrames && holdFrames >= p.loadHoldFrames && l.previousLoad > 0) {
+        if (current == l.previousIndex + 1)
+            l.relativeCost[current] = l.load / l.previousLoad;
+        else if (current + 1 == l.previousIndex)
+            l.relativeCost[l.previousIndex] = l.previousLoad / std::max(l.load, 1e-6f);
+    }
+    l.holdFrames = holdFrames;
+
+    // step down under the ratio which runs, if it is over the budget
+    if (l.load > budget) {
+        l.recoveryFrames = 0;
+        if (current > lowest && l.holdFrames >= p.loadHoldFrames)
+            l.cap = current - 1;
+        return;
+    }
+
+    // step up when the ratio which runs is the limit, and the next one would
+    // fit with some headroom
+    if (current != l.cap || l.cap == highest)
+        return;
+    unsigned next = l.cap + 1;
+    float predicted = l.load * l.relativeCost[next];
+    if (predicted < kLoadHeadroom * budget) {
+        l.recoveryFrames += frames;
+        if (l.recoveryFrames >= p.loadRecoveryFrames)
+            l.cap = next;
+    }
+    else
+        l.recoveryFrames = 0;
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::setupRamps(const Snapshot &p, bool immediate)
+{
+    uint32_t rampFrames = immediate ? 0 : p.rampFrames;
+
+    for (unsigned g = 0; g < GainCount; ++g) {
+        if (immediate)
+            fGainRamp[g].setValue(p.gainDb[g], p.gain[g]);
+        else
+            fGainRamp[g].setTarget(p.gainDb[g], p.gain[g], rampFrames);
+    }
+
+    // a band which is not heard fades out with its scale
+    for (unsigned b = 0; b < Bands; ++b) {
+        fShaperGainRamp[b].setTarget(p.shaper[b].gain, rampFrames);
+        fShaperScaleRamp[b].setTarget(p.bandActive[b] ? p.shaper[b].scale : 0.0f, rampFrames);
+    }
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::distortBand(unsigned band, float *inout, uint32_t over, uint32_t frames) const
+{
+    const LinearRamp &gainRamp = fShaperGainRamp[band];
+    const LinearRamp &scaleRamp = fShaperScaleRamp[band];
+
+    // the ramps advance by frames, interpolate them between oversampled frames;
+    // a mute ramps the scale alone, so they may end in different segments
+    uint32_t i = 0;
+    while (i < frames) {
+        uint32_t gainLeft = (gainRamp.getRemaining() > i) ? (gainRamp.getRemaining() - i) : 0;
+        uint32_t scaleLeft = (scaleRamp.getRemaining() > i) ? (scaleRamp.getRemaining() - i) : 0;
+        if (gainLeft == 0 && scaleLeft == 0) {
+            fKernels->distort(
+                inout + over * i, gainRamp.getTarget(), scaleRamp.getTarget(),
+                over * (frames - i));
+            break;
+        }
+
+        uint32_t segment = frames - i;
+        if (gainLeft > 0)
+            segment = std::min(segment, gainLeft);
+        if (scaleLeft > 0)
+            segment = std::min(segment, scaleLeft);
+
+        float gain = gainLeft ? (gainRamp.getValue() + i * gainRamp.getStep()) : gainRamp.getTarget();
+        float scale = scaleLeft ? (scaleRamp.getValue() + i * scaleRamp.getStep()) : scaleRamp.getTarget();
+        float gainStep = gainLeft ? gainRamp.getStep() : 0.0f;
+        float scaleStep = scaleLeft ? scaleRamp.getStep() : 0.0f;
+        fKernels->distortRamp(
+            inout + over * i, gain, scale, gainStep / over, scaleStep / over, over * segment);
+        i += segment;
+    }
+}
+
+template <unsigned NBands>
+bool QuadrafuzzEngine<NBands>::isBandSilent(unsigned band) const
+{
+    const LinearRamp &scaleRamp = fShaperScaleRamp[band];
+    return !scaleRamp.isRamping() && scaleRamp.getTarget() == 0;
+}
+
+template <unsigned NBands>
+float QuadrafuzzEngine<NBands>::gateEnergy(unsigned band, uint32_t overFrames) const
+{
+    // the energy of the filtered signal, which the shaper would bring to
+    // the threshold with its largest gain, `scale / pi` at low levels
+    const LinearRamp &scaleRamp = fShaperScaleRamp[band];
+    float scale = std::max(scaleRamp.getValue(), scaleRamp.getTarget());
+    float level = kGateThreshold * (float)M_PI / scale;
+    return level * level * overFrames;
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::advanceShaperRamps(uint32_t frames)
+{
+    for (unsigned b = 0; b < Bands; ++b) {
+        fShaperGainRamp[b].advance(frames);
+        fShaperScaleRamp[b].advance(frames);
+    }
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::computeOversamplingIndex(Snapshot &p) const
+{
+    // the entry of a ratio, or for the fixed rate, the entry of the ratio
+    // which is the closest to the target, by their quotient
+    unsigned choice = 0;
+    double closest = 0;
+    for (unsigned index = 0; index < OversamplingValues.size(); ++index) {
+        int over = OversamplingValues[index].first;
+        if (over == p.oversampling && over != OversamplingFixedRate) {
+            choice = index;
+            break;
+        }
+        if (p.oversampling != OversamplingFixedRate || !isOversamplingRatio(over))
+            continue;
+        double distance = std::fabs(std::log(p.sampleRate * over / kFixedRate));
+        if (choice == 0 || distance < closest) {
+            choice = index;
+            closest = distance;
+        }
+    }
+    p.oversamplingIndex = choice;
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::computeBandFilters(Snapshot &p) const
+{
+    for (unsigned index = 0; index < OversamplingValues.size(); ++index) {
+        if (!isOversamplingRatio(OversamplingValues[index].first))
+            continue;
+
+        WebCore::Biquad::Coefficients *bandFilter = p.bandFilter[index];
+        double fs = p.sampleRate * OversamplingValues[index].first;
+        double fnorm = 1.0 / (0.5 * fs);
+
+        WebCore::Biquad filter;
+        for (unsigned b = 0; b < Bands; ++b) {
+            double frequency = getBand(b).frequency * fnorm;
+            if (b == 0)
+                filter.setLowpassParams(frequency, M_SQRT1_2);
+            else if (b == Bands - 1)
+                filter.setHighpassParams(frequency, M_SQRT1_2);
+            else
+                filter.setBandpassParams(frequency, M_SQRT1_2);
+            bandFilter[b] = filter.getCoefficients();
+        }
+    }
+
+    ++p.filterSerial;
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::computeBandActivity(Snapshot &p) const
+{
+    bool solo = false;
+    for (unsigned b = 0; b < Bands; ++b)
+        solo = solo || fSolo[b];
+
+    for (unsigned b = 0; b < Bands; ++b)
+        p.bandActive[b] = !fMute[b] && (!solo || fSolo[b]);
+}
+
+template <unsigned NBands>
+void QuadrafuzzEngine<NBands>::computeTransition(Snapshot &p) const
+{
+    p.warmUpFrames = (uint32_t)(kWarmUpTime * p.sampleRate);
+    p.crossfadeFrames = std::max<uint32_t>(1, kCrossfadeTime * p.sampleRate);
+
+    double step = 0.5 * M_PI / p.crossfadeFrames;
+    p.crossfadeCos = std::cos(step);
+    p.crossfadeSin = std::sin(step);
+}
+
+template <unsigned NBands>
+typename QuadrafuzzEngine<NBands>::ShaperCoefficients QuadrafuzzEngine<NBands>::shaperCoefficients(float drive)
+{
+    float pi = M_PI;
+    float gain = 150 * drive;
+
+    ShaperCoefficients sc;
+    sc.gain = gain;
+    sc.scale = (3 + gain) * (20 * pi / 180.0);
+    return sc;
+}
+
+template class QuadrafuzzEngine<2>;
+template class QuadrafuzzEngine<4>;
+template class QuadrafuzzEngine<6>;
+template class QuadrafuzzEngine<8>;
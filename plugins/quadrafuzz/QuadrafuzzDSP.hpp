@@ -0,0 +1,651 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#include "DistrhoPluginInfo.h"
+#include "QuadrafuzzTelemetry.hpp"
+#include "QuadrafuzzKernels.hpp"
+#include "QuadrafuzzBands.hpp"
+#include "QuadrafuzzAliasModel.hpp"
+#include "QuadrafuzzFilterDesign.hpp"
+#include "QuadrafuzzKernelCache.hpp"
+#include "QuadrafuzzWorker.hpp"
+#include "QuadrafuzzConvolver.hpp"
+#include "QuadrafuzzPipeline.hpp"
+#include "ParameterRamp.hpp"
+#include "TripleBuffer.hpp"
+#include "SpscRing.hpp"
+#include "AlignedBuffer.hpp"
+#include "blink/Biquad.h"
+#include "caps/basics.h"
+#include "caps/dsp/Oversampler.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+#ifndef QUADRAFUZZ_CHUNK_FRAMES
+#   define QUADRAFUZZ_CHUNK_FRAMES 64
+#endif
+
+/* the value of the oversampling which targets a fixed internal rate */
+static constexpr int OversamplingFixedRate = -1;
+/* the value of the oversampling which follows the signal */
+static constexpr int OversamplingAuto = 0;
+/* the value of the oversampling of offline rendering, the last one, which
+   is too heavy for real time */
+static constexpr int OversamplingOffline = 16;
+
+static constexpr std::array<std::pair<int, const char *>, 7> OversamplingValues {{
+    {OversamplingFixedRate, "352.8k"},
+    {OversamplingAuto, "auto"},
+    {1, "none"},
+    {2, "2x"},
+    {4, "4x"},
+    {8, "8x"},
+    {OversamplingOffline, "16x"},
+}};
+
+/* whether a value of the oversampling is a ratio, rather than a mode which picks one */
+static constexpr bool isOversamplingRatio(int value) { return value >= 1; }
+
+/* the specification of the filters of the oversamplers: the response of the
+   windowed sinc of the caps library at 16 taps per input sample, rounded,
+   with its aliasband where the aliases fold back under 20 kHz at 44.1 kHz */
+static constexpr QuadrafuzzFilterSpec OversamplerSpec {0.2, 0.3, 1 - 20e3 / 44.1e3, 1.5, 21, 35};
+
+/* the length of kernel for an oversampler which keeps the windowed sinc */
+static constexpr int kWindowedKernel = 0;
+
+/**
+ * An oversampler of the caps library, with an equiripple kernel of `Taps`
+ * coefficients in place of the windowed sinc, or with the windowed sinc of
+ * `FIRSize` taps when `Taps` is `kWindowedKernel`. The storage keeps a
+ * length which is a power of two, as the histories of the caps filters
+ * need, and the rest of the kernel is zero. The kernel comes from the cache
+ * at construction, which designs it the first time, and construction must
+ * not happen on the audio thread.
+ */
+template <int Over, int FIRSize, int Taps>
+class EquirippleOversampler : public DSP::Oversampler<Over, FIRSize>
+{
+public:
+    enum { KernelTaps = (Taps == kWindowedKernel) ? FIRSize : Taps };
+    enum { IsEquiripple = (Taps != kWindowedKernel) };
+    static_assert(KernelTaps <= FIRSize && KernelTaps % Over == 0, "the kernel does not fit the oversampler");
+
+    EquirippleOversampler()
+    {
+        // if the exchange fails, it keeps the windowed sinc
+        float kernel[KernelTaps];
+        if (!IsEquiripple || !QuadrafuzzKernelCache::get().equiripple(OversamplerSpec, Over, KernelTaps, kernel))
+            return;
+        for (int i = 0; i < FIRSize; ++i) {
+            float c = (i < KernelTaps) ? kernel[i] : 0;
+            this->fir.down.c[i] = c;
+            this->fir.up.c[i] = Over * c;
+        }
+    }
+};
+
+/**
+ * The processing core of the plugin, independent of the DPF wrapper.
+ *
+ * It owns the parameter values, indexed by the IDs of DistrhoPluginInfo.h,
+ * and everything which is needed to run the mono signal path.
+ *
+ * Parameters may be set on another thread than the one which runs the
+ * processing. The setter computes all the derived values, and publishes
+ * them together as a snapshot, which `run` adopts at the start of a block.
+ * This keeps the conversions out of `run`, but not always off the audio
+ * thread: the LV2 wrapper of DPF sets the parameters which changed from
+ * its `run`, so the setter must be real-time safe as well.
+ *
+ * Changes of gains and drives are smoothed by ramps, which start at the
+ * frame where `run` adopts the new snapshot.
+ *
+ * A change of oversampling runs the new path alongside the current one,
+ * first to warm up its state, then to crossfade into it. Both paths are
+ * processed for the duration of the transition, `kWarmUpTime` and
+ * `kCrossfadeTime` together.
+ *
+ * The input and the output of `run` may be the same buffer.
+ *
+ * Blocks are processed in chunks, using scratch memory which depends on the
+ * block size and the chunk size. When `setBlockSize` or `setChunkSize`
+ * changes them, the worker allocates the new memory, and `run` adopts it at
+ * the start of a block, by an atomic exchange; the memory which it replaces
+ * goes back to the worker to be freed. So these may be called during `run`,
+ * from another thread, and until the new memory is adopted, the blocks are
+ * processed in chunks of the old size. The chunk size trades the overhead
+ * per chunk against the cache footprint of the scratch memory, which grows
+ * with the oversampling.
+ *
+ * The number of bands is a template parameter, so the loops over the bands
+ * have a fixed count, and the band filters fill a fixed number of groups of
+ * SIMD lanes. The drives of the bands take the parameter IDs from `pIdDrive`,
+ * and the IDs of the parameters after them depend on the number of bands.
+ *
+ * A band which is muted, or not soloed while others are, fades out with the
+ * ramp of its shaper scale. Once silent, it skips the shaper and the mix,
+ * and the filters of a group skip processing when all of its bands are
+ * silent. A group which resumes starts from a clear state, under the fade in.
+ *
+ * A band whose output would stay under `kGateThreshold` for `kGateHoldTime`
+ * is gated: it skips the shaper and the mix, like a silent band, until the
+ * first chunk where the signal returns. The output is estimated from the
+ * filtered signal, with the gain of the shaper at low levels. The gated
+ * bands of a group also skip the filters while the input itself is quiet,
+ * since the filters have no gain.
+ *
+ * The fixed rate oversampling picks the ratio which brings the sample rate
+ * closest to `kFixedRate`, so that the processing is the same at every
+ * sample rate, and costs less at the high ones.
+ *
+ * The automatic oversampling estimates the aliasing which each ratio would
+ * produce, from the level and the spectrum of the input, and from the drives,
+ * and it picks the lowest ratio whose estimate stays under the alias budget.
+ * It goes up at once, and down after the lower ratio has been enough for
+ * `kAutoHoldTime`, with the transitions of a change of oversampling.
+ *
+ * Under a CPU budget, the oversampling is limited to the ratios whose load,
+ * as the telemetry measures it against the block duration, stays under the
+ * budget. The limit steps down when the smoothed load goes over the budget,
+ * and back up when the load which the next ratio would have stays under
+ * `kLoadHeadroom` of the budget for `kLoadRecoveryTime`. It needs the
+ * telemetry, and has no effect when it is compiled out.
+ *
+ * In offline rendering, as told by `setOffline`, the oversampling runs at
+ * `OversamplingOffline`, whatever the parameters and the automatic choice,
+ * but under the limit of the CPU budget, or of `kOfflineLoadBudget` without
+ * one. The load still tells whether real time could keep up, so a host which
+ * was wrongly taken for offline does not get a ratio too heavy for it. The
+ * parameters are kept as they are, so back in real time, the oversampling
+ * returns to what it was, through the same transition.
+ *
+ * The output, after the mix of the dry and wet signals, goes through the
+ * convolution with the impulse response of a cabinet, if one is loaded. The worker reads the
+ * response, converts it to the sample rate, and prepares the convolver,
+ * which `run` adopts like the scratch memory, and crossfades into from the
+ * previous one over `kCrossfadeTime`.
+ *
+ * The processing may be pipelined over two threads, at the cost of a chunk
+ * of latency. A helper thread runs the upsampler and the band filters of a
+ * chunk, while `run` runs the shaper, the downsampler and the mix of the
+ * previous one, and the two chunks alternate between them. The decisions of
+ * the gate for a chunk are taken before the previous one went through the
+ * shaper, so a band which comes back out of the gate misses a chunk. The
+ * helper comes with the scratch memory, and the output goes through a delay
+ * of a chunk, which keeps the latency when a transition or a bypass runs
+ * on `run` alone, and so does all of the processing if the helper could not
+ * take the real-time priority of the audio thread.
+ */
+template <unsigned NBands>
+class QuadrafuzzEngine
+{
+public:
+    enum { Bands = NBands };
+
+    /* the IDs of the parameters which follow the drives */
+    enum {
+        ParameterOversampling = pIdDrive + Bands,
+        ParameterDspLoad,
+        ParameterDspLoadPeak,
+        ParameterMute,
+        ParameterSolo = ParameterMute + Bands,
+        ParameterActivity = ParameterSolo + Bands,
+        ParameterAliasBudget = ParameterActivity + Bands,
+        ParameterCpuBudget,
+        ParameterEffectiveOversampling,
+        ParameterCount
+    };
+
+    QuadrafuzzEngine();
+    ~QuadrafuzzEngine();
+
+    void setSampleRate(double sampleRate);
+    double getSampleRate() const { return fSampleRate; }
+
+    /* maximum number of frames of a block */
+    void setBlockSize(uint32_t maxFrames);
+    uint32_t getBlockSize() const { return fBlockSize; }
+
+    /* number of frames of a chunk, 0 for whole blocks */
+    void setChunkSize(uint32_t frames);
+    uint32_t getChunkSize() const { return fChunkSize; }
+
+    /* whether the processing is pipelined over a helper thread; the worker
+       prepares it with the memory of the chunks, and `run` adopts it */
+    void setPipelined(bool pipelined);
+    bool isPipelined() const { return fPipelined; }
+
+    /* the latency of the output in frames, a chunk when the processing is
+       pipelined, which `run` has since the start of the last block */
+    uint32_t getLatency() const { return fLatency.load(std::memory_order_relaxed); }
+
+    /* how many jobs of the pipeline the audio thread ran itself, because
+       the helper had not started them; to call from the audio thread */
+    unsigned getPipelineTakenJobs() const { return fPipeline ? fPipeline->getTakenJobs() : 0; }
+
+    /* loads the impulse response of the cabinet from a WAV file, or removes
+       it with an empty path; the worker reads it, and a message on the
+       standard error tells if it fails */
+    void loadImpulseResponse(const char *path);
+    /* sets the impulse response of the cabinet from samples at `sampleRate`,
+       or removes it with no samples */
+    void setImpulseResponse(const float *samples, uint32_t length, double sampleRate);
+    /* the length of the impulse response which `run` uses, 0 for none */
+    uint32_t getImpulseLength() const { return fImpulseLength.load(std::memory_order_relaxed); }
+
+    /* waits until the worker has allocated the memory of the last block and
+       chunk sizes, and prepared the last impulse response, which the next
+       `run` adopts */
+    void waitForWorker() { QuadrafuzzWorker::get().wait(this); }
+
+    float getParameterValue(uint32_t index) const;
+    void setParameterValue(uint32_t index, float value);
+
+    void run(const float *input, float *output, uint32_t frames);
+
+    /* whether the host renders offline, from any thread; it takes effect
+       at the start of the next block */
+    void setOffline(bool offline) { fOffline.store(offline, std::memory_order_relaxed); }
+    bool isOffline() const { return fOffline.load(std::memory_order_relaxed); }
+
+    struct ShaperCoefficients {
+        float gain;
+        float scale;
+    };
+
+    static ShaperCoefficients shaperCoefficients(float drive);
+
+    static const QuadrafuzzBand &getBand(unsigned band) { return QuadrafuzzBandLayout<NBands>::get()[band]; }
+
+    /* the kernels, selected at construction */
+    const QuadrafuzzKernels &getKernels() const { return *fKernels; }
+
+    QuadrafuzzTelemetry &getTelemetry() { return fTelemetry; }
+
+    /* the oversamplers, with the shortest equiripple kernels which meet
+       `OversamplerSpec`, as `bin/quadrafuzz-design` checks, where they are
+       cheaper than the windowed sincs: at 2x, 18 taps cost as much as 32,
+       and at 8x, the kernel which meets the spec is as long as the sinc */
+    typedef EquirippleOversampler<2, 32, kWindowedKernel> Oversampler2x;
+    typedef EquirippleOversampler<4, 64, 36> Oversampler4x;
+    typedef EquirippleOversampler<8, 64, kWindowedKernel> Oversampler8x;
+    typedef EquirippleOversampler<16, 128, 128> Oversampler16x;
+
+private:
+    enum Gain { GainInput, GainOutput, GainDry, GainWet, GainCount };
+
+    /* duration of the parameter ramps */
+    static constexpr double kRampTime = 20e-3;
+    /* duration of the phases of an oversampling transition */
+    static constexpr double kWarmUpTime = 10e-3;
+    static constexpr double kCrossfadeTime = 10e-3;
+    /* level of the output of a band under which it is gated, -90 dBFS,
+       and the time it has to stay under it */
+    static constexpr float kGateThreshold = 3.16e-5f;
+    static constexpr double kGateHoldTime = 50e-3;
+    /* the automatic oversampling decides after at least `kAutoWindowTime`
+       of input, and waits `kAutoHoldTime` before it goes down */
+    static constexpr double kAutoWindowTime = 5e-3;
+    static constexpr double kAutoHoldTime = 250e-3;
+    /* the CPU budget smooths the load over `kLoadSmoothTime`, steps down at
+       most once per `kLoadHoldTime`, and steps up after the next ratio would
+       have stayed under `kLoadHeadroom` of the budget for `kLoadRecoveryTime` */
+    static constexpr double kLoadSmoothTime = 50e-3;
+    static constexpr double kLoadHoldTime = 100e-3;
+    static constexpr double kLoadRecoveryTime = 2;
+    static constexpr float kLoadHeadroom = 0.7f;
+    /* the budget of the offline ratio without a CPU budget, in percent, so
+       that a host which goes back to real time can still keep up */
+    static constexpr float kOfflineLoadBudget = 50;
+
+    /* the internal rate which the fixed rate oversampling targets */
+    static constexpr double kFixedRate = 352800;
+
+    /* the largest oversampling */
+    static constexpr uint32_t kMaxOversampling = OversamplingOffline;
+
+    /* everything the processing needs from the parameters */
+    struct Snapshot {
+        bool bypass = false;
+        int oversampling = 1;
+        unsigned oversamplingIndex = 0;
+        double sampleRate = 44100;
+        uint32_t rampFrames = 0;
+        uint32_t warmUpFrames = 0;
+        uint32_t crossfadeFrames = 0;
+        uint32_t gateHoldFrames = 0;
+        uint32_t autoWindowFrames = 0;
+        uint32_t autoHoldFrames = 0;
+        /* the mean square of the aliases which the automatic oversampling allows */
+        float aliasBudget = 0;
+        /* the share of the block duration which the processing may take,
+           in percent, or 0 for no limit */
+        float cpuBudget = 0;
+        uint32_t loadHoldFrames = 0;
+        uint32_t loadRecoveryFrames = 0;
+        float crossfadeCos = 1;
+        float crossfadeSin = 0;
+        float gainDb[GainCount] = {};
+        float gain[GainCount] = {1, 1, 1, 1};
+        ShaperCoefficients shaper[Bands] = {};
+        /* whether each band is heard, according to the mutes and solos */
+        bool bandActive[Bands] = {};
+        /* band filters for every oversampling, computed for the sample rate;
+           the entries of the modes which pick a ratio are unused */
+        WebCore::Biquad::Coefficients bandFilter[OversamplingValues.size()][Bands] = {};
+        unsigned filterSerial = 0;
+    };
+
+    typedef QuadrafuzzKernels::BiquadGroup BiquadGroup;
+    /* the lanes past the last band have null filters */
+    enum { BandGroups = (Bands + BiquadGroup::Lanes - 1) / BiquadGroup::Lanes };
+    enum { BandLanes = BandGroups * BiquadGroup::Lanes };
+
+    /* the band filters which run at some oversampling */
+    struct Path {
+        unsigned oversampling = 0;
+        /* the entry of `OversamplingValues` */
+        unsigned index = 0;
+        BiquadGroup filters[BandGroups];
+        /* whether the filters of a group have skipped processing */
+        bool groupIdle[BandGroups] = {};
+        /* how long each band has been quiet, for the gate */
+        uint32_t quietFrames[Bands] = {};
+        /* how many oversampled frames of silence went to the downsampler */
+        uint32_t silentFrames = 0;
+        /* the energy of the oversampled input and of the bands since the
+           last decision of the automatic oversampling */
+        float inputEnergy = 0;
+        float bandEnergy[Bands] = {};
+    };
+
+    /* the state of the automatic oversampling */
+    struct AutoOversampling {
+        /* the chosen entry of `OversamplingValues` */
+        unsigned index = 0;
+        /* the highest entry which was enough while waiting to go down */
+        unsigned holdIndex = 0;
+        uint32_t holdFrames = 0;
+        /* the statistics of the input since the last decision */
+        uint32_t frames = 0;
+        float inputEnergy = 0;
+        float differenceEnergy = 0;
+        float lastInput = 0;
+        /* the share of each band in the energy of the input */
+        float bandShare[Bands];
+    };
+
+    /* the state of the CPU budget */
+    struct LoadLimit {
+        /* the highest entry of `OversamplingValues` which may run */
+        unsigned cap = OversamplingValues.size() - 1;
+        /* the entry which was measured, and its smoothed load in percent */
+        unsigned index = 0;
+        float load = 0;
+        /* the entry which ran before, and its load when it stopped */
+        unsigned previousIndex = 0;
+        float previousLoad = 0;
+        /* the load of each entry relative to the entry under it, as measured
+           across a change between them, or else the ratio of oversampling */
+        float relativeCost[OversamplingValues.size()];
+        uint32_t holdFrames = 0;
+        uint32_t recoveryFrames = 0;
+    };
+
+    /* a chunk of a path between the steps of its processing: the decisions
+       which are taken before the filters, and the oversampled signals */
+    struct Stage {
+        const float *input = nullptr;
+        uint32_t frames = 0;
+        float *bandIn = nullptr;
+        float *bandOut[BandLanes] = {};
+        /* whether the path is silent, and skips the processing */
+        bool silent = false;
+        /* whether the automatic oversampling measures the input, and the
+           energy of the oversampled input */
+        bool measure = false;
+        float inputEnergy = 0;
+        bool heard[Bands] = {};
+        float quietEnergy[Bands] = {};
+        bool groupActive[BandGroups] = {};
+        /* whether the filters of a group resume from a clear state */
+        bool groupReset[BandGroups] = {};
+        unsigned groupCount = 0;
+    };
+
+    enum PathStep { kPlanStep, kFilterStep, kFinishStep };
+
+    /* the gains which are applied after the path, as ramps if they change */
+    struct ChunkMix {
+        bool gainRamp = false;
+        float outputGain = 1;
+        float *outputGainRamp = nullptr;
+    };
+
+    /* a chunk in the pipeline, with its own copies of the signals */
+    struct PipelineChunk {
+        QuadrafuzzEngine *engine = nullptr;
+        Path *path = nullptr;
+        Stage stage;
+        ChunkMix mix;
+        float *wet = nullptr;
+        float *dry = nullptr;
+    };
+
+    struct Resources;
+    static Resources *createResources(uint32_t blockSize, uint32_t chunkSize, bool pipelined);
+    void requestResources();
+    void installResources(Resources *resources);
+    void scheduleReclaim();
+    void reclaimResources();
+    void adoptResources();
+    struct Cabinet;
+    void updateCabinet(double sampleRate);
+    void installCabinet(Cabinet *cabinet);
+    void adoptCabinet();
+    void runCabinet(const Snapshot &p, float *inout, uint32_t frames);
+    void runChunk(const Snapshot &p, const float *input, float *output, uint32_t frames);
+    void beginChunk(ChunkMix &mix, const float *input, float *wet, float *dry, uint32_t frames);
+    void endChunk(const Snapshot &p, const ChunkMix &mix, float *wet, float *output, uint32_t frames);
+    void runDelayedChunk(const Snapshot &p, const float *input, float *output, uint32_t frames);
+    void runPipelinedChunk(const Snapshot &p, const float *input, uint32_t frames);
+    static void runPipelineJob(void *data);
+    void finishPipelinedChunk(const Snapshot &p);
+    void drainPipeline(const Snapshot &p);
+    void runTransition(const Snapshot &p, const float *input, float *output, uint32_t frames);
+    void runPath(const Snapshot &p, Path &path, const float *input, float *output, uint32_t frames);
+    template <class Oversampler> void runPathWithOversampler(const Snapshot &p, Oversampler &os, Path &path, const float *input, float *output, uint32_t frames);
+    void runPathStep(PathStep step, const Snapshot *p, Path &path, Stage &stage, const float *input, float *output);
+    template <class Oversampler> void runPathStepWithOversampler(PathStep step, const Snapshot *p, Oversampler &os, Path &path, Stage &stage, const float *input, float *output);
+    template <class Oversampler> void planStage(const Snapshot &p, Oversampler &os, Path &path, Stage &stage, const float *input);
+    template <class Oversampler> void upsampleStage(Oversampler &os, Stage &stage);
+    void filterStage(Path &path, Stage &stage);
+    template <class Oversampler> void finishStage(const Snapshot &p, Oversampler &os, Path &path, Stage &stage, float *output, uint64_t &t);
+    void setupPath(Path &path, const Snapshot &p, unsigned index);
+    void setupFilters(const Snapshot &p, unsigned index);
+    void beginTransition(const Snapshot &p, unsigned index);
+    unsigned chooseOversampling(const Snapshot &p, const float *input, uint32_t frames);
+    float estimateAliasing(const Snapshot &p, unsigned index, float inputEnergy, float inputFrequency) const;
+    void updateLoadLimit(const Snapshot &p, uint32_t frames);
+    void setupRamps(const Snapshot &p, bool immediate);
+    void distortBand(unsigned band, float *inout, uint32_t over, uint32_t frames) const;
+    bool isBandSilent(unsigned band) const;
+    float gateEnergy(unsigned band, uint32_t overFrames) const;
+    void advanceShaperRamps(uint32_t frames);
+    void computeOversamplingIndex(Snapshot &p) const;
+    void computeBandFilters(Snapshot &p) const;
+    void computeBandActivity(Snapshot &p) const;
+    void computeTransition(Snapshot &p) const;
+    void publishSnapshot();
+
+private:
+    double fSampleRate = 44100;
+
+    bool fBypass = false;
+    int fOversampling = 1;
+    float fInputGain = 0;
+    float fOutputGain = 0;
+    float fDryGain = 0;
+    float fWetGain = 0;
+    float fDrive[Bands] = {};
+    bool fMute[Bands] = {};
+    bool fSolo[Bands] = {};
+    float fAliasBudget = -80;
+    float fCpuBudget = 0;
+
+    /* the writer's copy of the snapshot, and the exchange with `run` */
+    Snapshot fPending;
+    TripleBuffer<Snapshot> fSnapshot;
+
+    const QuadrafuzzKernels *fKernels = nullptr;
+    const QuadrafuzzAliasModel *fAliasModel = nullptr;
+
+    unsigned fActiveFilterSerial = 0;
+
+    /* the sizes which were set last, which the memory may not have yet */
+    uint32_t fBlockSize = 4096;
+    uint32_t fChunkSize = QUADRAFUZZ_CHUNK_FRAMES;
+    bool fPipelined = false;
+
+    /* scratch memory of the chunk processing, with arrays of `fChunkFrames`,
+       and oversampled arrays of `kMaxOversampling * fChunkFrames` */
+    struct Scratch {
+        float *inputGain = nullptr;
+        float *dryGain = nullptr;
+        float *wetGain = nullptr;
+        float *outputGain = nullptr;
+        float *wet = nullptr;
+        float *targetOutput = nullptr;
+        float *bandIn = nullptr;
+        /* the unused lanes share an output, which is discarded */
+        float *bandOut[BandLanes] = {};
+    };
+
+    /* the memory of a chunk size, and the pipeline if there is one */
+    struct Resources {
+        uint32_t chunkFrames = 0;
+        AlignedBuffer<float> memory;
+        Scratch scratch;
+        std::unique_ptr<QuadrafuzzPipeline> pipeline;
+        PipelineChunk chunks[2];
+        /* the output of the pipeline, up to two chunks */
+        float *delay = nullptr;
+    };
+
+    /* how often the worker looks for the resources which `run` replaced */
+    static constexpr double kReclaimInterval = 100e-3;
+
+    /* the resources which `run` uses, and its copies of their fields */
+    Resources *fResources = nullptr;
+    uint32_t fChunkFrames = 0;
+    Scratch fScratch;
+    QuadrafuzzPipeline *fPipeline = nullptr;
+    PipelineChunk *fPipelineChunks = nullptr;
+    unsigned fNextPipelineChunk = 0;
+    /* the chunk which the helper runs, or ran, and which `run` finishes */
+    PipelineChunk *fPendingChunk = nullptr;
+    float *fDelay = nullptr;
+    uint32_t fDelayFill = 0;
+    std::atomic<uint32_t> fLatency{0};
+    /* the resources which the worker published, for `run` to adopt, and the
+       ones which `run` replaced, for the worker to free */
+    std::atomic<Resources *> fNextResources{nullptr};
+    enum { kRetiredCapacity = 4 };
+    SpscRing<Resources *, kRetiredCapacity> fRetired;
+    /* on the worker, the published resources which are not freed yet, and
+       whether it looks for them later; when it stopped looking, the next
+       installation or the destruction frees them */
+    unsigned fUnreclaimed = 0;
+    bool fReclaimScheduled = false;
+
+    /* the convolution of a cabinet, or none without a convolver */
+    struct Cabinet {
+        std::unique_ptr<QuadrafuzzConvolver> convolver;
+    };
+
+    /* the cabinet which `run` uses, and the previous one while it fades out */
+    Cabinet *fCabinet = nullptr;
+    Cabinet *fFadingCabinet = nullptr;
+    uint32_t fCabinetFadeFrame = 0;
+    float fCabinetFadeCos = 1;
+    float fCabinetFadeSin = 0;
+    std::atomic<uint32_t> fImpulseLength{0};
+    /* the cabinet which the worker published, and the ones which `run`
+       replaced, like the resources */
+    std::atomic<Cabinet *> fNextCabinet{nullptr};
+    SpscRing<Cabinet *, kRetiredCapacity> fRetiredCabinets;
+    /* on the worker, the impulse response at its own sample rate */
+    std::vector<float> fImpulse;
+    double fImpulseRate = 0;
+
+    /* the active path, and the other one which is used in transitions */
+    Path fPath[2];
+    unsigned fActivePath = 0;
+    bool fTransition = false;
+    uint32_t fTransitionFrame = 0;
+    float fCrossfadeCos = 1;
+    float fCrossfadeSin = 0;
+
+    AutoOversampling fAuto;
+    /* the largest power gain of the downsampler of each ratio, above the
+       Nyquist frequency, which leaks the harmonics it should remove */
+    float fStopbandGain[OversamplingValues.size()] = {};
+
+    LoadLimit fLoadLimit;
+    /* the ratio of the active path, after the last block */
+    std::atomic<unsigned> fEffectiveOversampling{1};
+
+    std::atomic<bool> fOffline{false};
+
+    /* the bands which were processed during the block, and the last block */
+    uint32_t fBlockActivity = 0;
+    std::atomic<uint32_t> fBandActivity{0};
+
+    bool fRampsInitialized = false;
+    GainRamp fGainRamp[GainCount];
+    LinearRamp fShaperGainRamp[Bands];
+    LinearRamp fShaperScaleRamp[Bands];
+
+    Oversampler2x fOver2x;
+    Oversampler4x fOver4x;
+    Oversampler8x fOver8x;
+    Oversampler16x fOver16x;
+
+    QuadrafuzzTelemetry fTelemetry;
+};
+
+extern template class QuadrafuzzEngine<2>;
+extern template class QuadrafuzzEngine<4>;
+extern template class QuadrafuzzEngine<6>;
+extern template class QuadrafuzzEngine<8>;
+
+/* the engine of this build of the plugin */
+typedef QuadrafuzzEngine<QUADRAFUZZ_BANDS> QuadrafuzzDSP;
+static_assert((int)QuadrafuzzDSP::ParameterCount == Parameter_Count, "the parameter IDs must match the engine");
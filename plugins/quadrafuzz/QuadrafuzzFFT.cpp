@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "QuadrafuzzFFT.hpp"
+#include <cmath>
+#include <cassert>
+
+QuadrafuzzFFT::QuadrafuzzFFT(uint32_t size)
+    : fSize(size)
+{
+    assert(size >= 4 && (size & (size - 1)) == 0);
+
+    const uint32_t half = size / 2;
+    fReversed.resize(half, 0);
+    for (uint32_t i = 1, j = 0; i < half; ++i) {
+        uint32_t bit = half >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        fReversed[i] = j;
+    }
+
+    fTwiddleRe.resize(half);
+    fTwiddleIm.resize(half);
+    for (uint32_t m = 1; m < half; m *= 2) {
+        for (uint32_t k = 0; k < m; ++k) {
+            fTwiddleRe[m + k] = (float)std::cos(M_PI * k / m);
+            fTwiddleIm[m + k] = (float)-std::sin(M_PI * k / m);
+        }
+    }
+
+    fSplitRe.resize(half + 1);
+    fSplitIm.resize(half + 1);
+    for (uint32_t k = 0; k <= half; ++k) {
+        fSplitRe[k] = (float)std::cos(2 * M_PI * k / size);
+        fSplitIm[k] = (float)-std::sin(2 * M_PI * k / size);
+    }
+
+    fWorkRe.resize(half);
+    fWorkIm.resize(half);
+
+    for (uint32_t m = 2; m <= half; m *= 2)
+        ++fStages;
+    if (half >= 4)
+        --fStages;
+}
+
+void QuadrafuzzFFT::transformStage(uint32_t stage, float *re, float *im) const
+{
+    const uint32_t n = fSize / 2;
+
+    // the first two stages together, whose twiddles are 1 and -i
+    if (n >= 4 && stage == 0) {
+        for (uint32_t i = 0; i < n; i += 4) {
+            float *r = re + i, *s = im + i;
+            float ar0 = r[0] + r[1], ai0 = s[0] + s[1];
+            float ar1 = r[0] - r[1], ai1 = s[0] - s[1];
+            float ar2 = r[2] + r[3], ai2 = s[2] + s[3];
+            float ar3 = r[2] - r[3], ai3 = s[2] - s[3];
+            r[0] = ar0 + ar2;
+            s[0] = ai0 + ai2;
+            r[2] = ar0 - ar2;
+            s[2] = ai0 - ai2;
+            r[1] = ar1 + ai3;
+            s[1] = ai1 - ar3;
+            r[3] = ar1 - ai3;
+            s[3] = ai1 + ar3;
+        }
+        return;
+    }
+
+    const uint32_t m = (n >= 4) ? (2u << stage) : 1;
+    const float *wr = &fTwiddleRe[m];
+    const float *wi = &fTwiddleIm[m];
+    for (uint32_t i = 0; i < n; i += 2 * m) {
+        float *ar = re + i, *ai = im + i;
+        float *br = ar + m, *bi = ai + m;
+        for (uint32_t k = 0; k < m; ++k) {
+            float vr = br[k] * wr[k] - bi[k] * wi[k];
+            float vi = br[k] * wi[k] + bi[k] * wr[k];
+            float ur = ar[k], ui = ai[k];
+            ar[k] = ur + vr;
+            ai[k] = ui + vi;
+            br[k] = ur - vr;
+            bi[k] = ui - vi;
+        }
+    }
+}
+
+void QuadrafuzzFFT::forward(const float *input, float *re, float *im)
+{
+    for (uint32_t step = 0, count = getStepCount(); step < count; ++step)
+        forwardStep(step, input, re, im);
+}
+
+void QuadrafuzzFFT::inverse(const float *re, const float *im, float *output)
+{
+    for (uint32_t step = 0, count = getStepCount(); step < count; ++step)
+        inverseStep(step, re, im, output);
+}
+
+void QuadrafuzzFFT::forwardStep(uint32_t step, const float *input, float *re, float *im)
+{
+    const uint32_t half = fSize / 2;
+    float *zr = fWorkRe.data();
+    float *zi = fWorkIm.data();
+
+    if (step == 0) {
+        // the even samples as the real part, and the odd ones as the imaginary
+        for (uint32_t i = 0; i < half; ++i) {
+            zr[fReversed[i]] = input[2 * i];
+            zi[fReversed[i]] = input[2 * i + 1];
+        }
+    }
+    else if (step <= fStages)
+        transformStage(step - 1, zr, zi);
+    else {
+        // X[k] = E[k] + W^k O[k], where E and O are the spectra of the even
+        // and the odd samples, from Z[k] and the conjugate of Z[half - k]
+        uint32_t part = step - fStages - 1;
+        uint32_t end = (part + 1) * (half + 1) / kSeparationSteps;
+        for (uint32_t k = part * (half + 1) / kSeparationSteps; k < end; ++k) {
+            uint32_t j = (k == half) ? 0 : k;
+            uint32_t l = (k == 0) ? 0 : half - k;
+            float er = 0.5f * (zr[j] + zr[l]);
+            float ei = 0.5f * (zi[j] - zi[l]);
+            float or_ = 0.5f * (zi[j] + zi[l]);
+            float oi = -0.5f * (zr[j] - zr[l]);
+            re[k] = er + fSplitRe[k] * or_ - fSplitIm[k] * oi;
+            im[k] = ei + fSplitRe[k] * oi + fSplitIm[k] * or_;
+        }
+    }
+}
+
+void QuadrafuzzFFT::inverseStep(uint32_t step, const float *re, const float *im, float *output)
+{
+    const uint32_t half = fSize / 2;
+    float *zr = fWorkRe.data();
+    float *zi = fWorkIm.data();
+
+    if (step < kSeparationSteps) {
+        // the reverse of the separation, doubled so that the result is
+        // scaled by `fSize` like the transform of the whole signal, into the
+        // bit reversed order of the complex FFT
+        uint32_t end = (step + 1) * half / kSeparationSteps;
+        for (uint32_t k = step * half / kSeparationSteps; k < end; ++k) {
+            float er = re[k] + re[half - k];
+            float ei = im[k] - im[half - k];
+            float dr = re[k] - re[half - k];
+            float di = im[k] + im[half - k];
+            // the odd part, times the conjugate twiddle, then times i
+            float or_ = dr * fSplitRe[k] + di * fSplitIm[k];
+            float oi = di * fSplitRe[k] - dr * fSplitIm[k];
+            zr[fReversed[k]] = er - oi;
+            zi[fReversed[k]] = ei + or_;
+        }
+    }
+    else if (step < kSeparationSteps + fStages)
+        transformStage(step - kSeparationSteps, zi, zr);
+    else {
+        for (uint32_t i = 0; i < half; ++i) {
+            output[2 * i] = zr[i];
+            output[2 * i + 1] = zi[i];
+        }
+    }
+}
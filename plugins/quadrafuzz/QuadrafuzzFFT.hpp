@@ -0,0 +1,84 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#pragma once
+#include <vector>
+#include <cstdint>
+
+/**
+ * FFT of real signals, of a size which is a power of two, for the block
+ * convolution. It runs a complex FFT of half the size on the even and the
+ * odd samples, and separates their spectra.
+ *
+ * The spectra have `size / 2 + 1` bins, split into their real and imaginary
+ * parts. The inverse transform is not scaled: it gives `size` times the
+ * signal. The complex FFT keeps the real and the imaginary parts apart too,
+ * with the twiddles of each stage in a row, so that its butterflies are
+ * vectorized. The tables are computed at construction, and the transforms
+ * do not allocate, but they share a work buffer, so an instance is for one
+ * thread.
+ *
+ * A transform may also run in steps, of about the same cost each, to spread
+ * it over time: the steps from 0 to `getStepCount() - 1` make one transform,
+ * and the work buffer is in use from the first to the last.
+ */
+class QuadrafuzzFFT
+{
+public:
+    explicit QuadrafuzzFFT(uint32_t size);
+
+    uint32_t getSize() const { return fSize; }
+    uint32_t getBins() const { return fSize / 2 + 1; }
+
+    void forward(const float *input, float *re, float *im);
+    void inverse(const float *re, const float *im, float *output);
+
+    /* the loading, each stage of the complex FFT, and the separation, which
+       costs about three stages, in parts of the bins */
+    enum { kSeparationSteps = 3 };
+    uint32_t getStepCount() const { return fStages + 1 + kSeparationSteps; }
+    void forwardStep(uint32_t step, const float *input, float *re, float *im);
+    void inverseStep(uint32_t step, const float *re, const float *im, float *output);
+
+private:
+    /* a stage of the complex FFT of `fSize / 2` points in place, from the
+       bit reversed order; the inverse is the same with `re` and `im`
+       swapped */
+    void transformStage(uint32_t stage, float *re, float *im) const;
+
+    uint32_t fSize = 0;
+    /* the stages of the complex FFT, whose first two are one */
+    uint32_t fStages = 0;
+    /* the bit reversed indices of the complex FFT */
+    std::vector<uint32_t> fReversed;
+    /* the twiddles of the stages of the complex FFT, with `m` butterflies
+       from the index `m`: `exp(-2 pi i k / (2 m))` */
+    std::vector<float> fTwiddleRe;
+    std::vector<float> fTwiddleIm;
+    /* the twiddles which separate the spectra, `exp(-2 pi i k / size)` */
+    std::vector<float> fSplitRe;
+    std::vector<float> fSplitIm;
+    std::vector<float> fWorkRe;
+    std::vector<float> fWorkIm;
+};
@@ -0,0 +1,275 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "QuadrafuzzFilterDesign.hpp"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+bool QuadrafuzzFilterResponse::meets(const QuadrafuzzFilterSpec &spec) const
+{
+    return ripple <= spec.ripple &&
+        stopAttenuation >= spec.stopAttenuation &&
+        aliasAttenuation >= spec.aliasAttenuation;
+}
+
+namespace {
+
+/* the exchange runs on a grid of this many points per coefficient */
+constexpr unsigned kGridDensity = 16;
+/* the weight of the error at DC against the rest of the passband */
+constexpr double kDCWeight = 10;
+constexpr unsigned kMaxIterations = 100;
+constexpr double kConvergence = 1e-6;
+
+struct GridPoint {
+    double w, desired, weight;
+    unsigned band;
+};
+
+/* solves `a x = b` in place into `b`, by the elimination of Gauss with
+   partial pivoting, where `a` is `n` by `n` by rows */
+bool solve(std::vector<double> &a, std::vector<double> &b, unsigned n)
+{
+    for (unsigned col = 0; col < n; ++col) {
+        unsigned pivot = col;
+        for (unsigned row = col + 1; row < n; ++row) {
+            if (std::fabs(a[row * n + col]) > std::fabs(a[pivot * n + col]))
+                pivot = row;
+        }
+        if (a[pivot * n + col] == 0)
+            return false;
+        if (pivot != col) {
+            std::swap_ranges(&a[pivot * n], &a[pivot * n] + n, &a[col * n]);
+            std::swap(b[pivot], b[col]);
+        }
+        for (unsigned row = col + 1; row < n; ++row) {
+            double factor = a[row * n + col] / a[col * n + col];
+            for (unsigned k = col; k < n; ++k)
+                a[row * n + k] -= factor * a[col * n + k];
+            b[row] -= factor * b[col];
+        }
+    }
+    for (unsigned row = n; row-- > 0;) {
+        double sum = b[row];
+        for (unsigned k = row + 1; k < n; ++k)
+            sum -= a[row * n + k] * b[k];
+        b[row] = sum / a[row * n + row];
+    }
+    return true;
+}
+
+/* the amplitude of an even symmetric kernel, from its half `b`, as
+   `sum of b[k] * cos((k + 1/2) * w)` */
+double amplitude(const double *b, unsigned half, double w)
+{
+    double sum = 0;
+    for (unsigned k = 0; k < half; ++k)
+        sum += b[k] * std::cos((k + 0.5) * w);
+    return sum;
+}
+
+} // namespace
+
+double designEquiripple(const QuadrafuzzFilterSpec &spec, unsigned over, unsigned taps, float *kernel)
+{
+    // an even length has a zero at the Nyquist frequency, which suits a
+    // lowpass, and the amplitude has one cosine of half a sample per pair
+    const unsigned half = taps / 2;
+    const unsigned extremals = half + 1;
+    if (half == 0 || taps % 2 != 0)
+        return -1;
+
+    const double scale = 2 * M_PI / over;
+    struct Band { double low, high, desired, tolerance; };
+    const Band bands[] = {
+        {0, spec.passband * scale, 1, 1 - std::pow(10.0, -spec.ripple / 20)},
+        {spec.stopband * scale, spec.aliasband * scale, 0, std::pow(10.0, -spec.stopAttenuation / 20)},
+        {spec.aliasband * scale, M_PI, 0, std::pow(10.0, -spec.aliasAttenuation / 20)},
+    };
+
+    // the grid, on which the two parts of the stopband do not share a point
+    std::vector<GridPoint> grid;
+    const double step = M_PI / (kGridDensity * half);
+    for (unsigned band = 0; band < 3; ++band) {
+        const Band &bd = bands[band];
+        unsigned points = std::max(2u, (unsigned)std::ceil((bd.high - bd.low) / step));
+        bool closed = band == 0;
+        for (unsigned i = 0; i < points + closed; ++i) {
+            double w = bd.low + i * (bd.high - bd.low) / points;
+            double weight = (w == 0) ? kDCWeight / bd.tolerance : 1 / bd.tolerance;
+            grid.push_back(GridPoint{w, bd.desired, weight, band});
+        }
+    }
+    const unsigned size = grid.size();
+    if (size < extremals)
+        return -1;
+
+    std::vector<unsigned> extremal(extremals);
+    for (unsigned i = 0; i < extremals; ++i)
+        extremal[i] = (unsigned)((uint64_t)i * (size - 1) / half);
+
+    std::vector<double> matrix(extremals * extremals);
+    std::vector<double> solution(extremals);
+    std::vector<double> error(size);
+    std::vector<unsigned> candidates;
+    candidates.reserve(size);
+
+    double maxError = -1;
+    for (unsigned iteration = 0; iteration < kMaxIterations; ++iteration) {
+        // the amplitude which has an error of alternate signs and equal
+        // weighted magnitudes at the extremal points
+        for (unsigned i = 0; i < extremals; ++i) {
+            const GridPoint &pt = grid[extremal[i]];
+            double *row = &matrix[i * extremals];
+            for (unsigned k = 0; k < half; ++k)
+                row[k] = std::cos((k + 0.5) * pt.w);
+            row[half] = ((i & 1) ? -1 : 1) / pt.weight;
+            solution[i] = pt.desired;
+        }
+        if (!solve(matrix, solution, extremals))
+            return -1;
+        const double delta = std::fabs(solution[half]);
+
+        maxError = 0;
+        for (unsigned j = 0; j < size; ++j) {
+            const GridPoint &pt = grid[j];
+            error[j] = pt.weight * (pt.desired - amplitude(solution.data(), half, pt.w));
+            maxError = std::max(maxError, std::fabs(error[j]));
+        }
+        if (maxError - delta <= kConvergence * maxError)
+            break;
+
+        // the local extrema of the error in each band, with the edges
+        candidates.clear();
+        for (unsigned j = 0; j < size; ++j) {
+            bool first = j == 0 || grid[j - 1].band != grid[j].band;
+            bool last = j + 1 == size || grid[j + 1].band != grid[j].band;
+            double e = error[j];
+            bool peak = e > 0 && (first || e >= error[j - 1]) && (last || e >= error[j + 1]);
+            bool trough = e < 0 && (first || e <= error[j - 1]) && (last || e <= error[j + 1]);
+            if (!peak && !trough)
+                continue;
+            // of two neighbours of the same sign, keep the larger
+            if (!candidates.empty() && (error[candidates.back()] > 0) == (e > 0)) {
+                if (std::fabs(e) > std::fabs(error[candidates.back()]))
+                    candidates.back() = j;
+                continue;
+            }
+            candidates.push_back(j);
+        }
+        if (candidates.size() < extremals)
+            break;
+
+        // drop the smallest, keeping the signs alternate
+        while (candidates.size() > extremals) {
+            unsigned n = candidates.size();
+            unsigned smallest = 0;
+            for (unsigned i = 1; i < n; ++i) {
+                if (std::fabs(error[candidates[i]]) < std::fabs(error[candidates[smallest]]))
+                    smallest = i;
+            }
+            if (n == extremals + 1 || smallest == 0 || smallest == n - 1) {
+                bool front = std::fabs(error[candidates.front()]) < std::fabs(error[candidates.back()]);
+                if (front)
+                    candidates.erase(candidates.begin());
+                else
+                    candidates.pop_back();
+                continue;
+            }
+            // its neighbours then have the same sign, so drop the smaller too
+            unsigned neighbour = (std::fabs(error[candidates[smallest - 1]]) <
+                                  std::fabs(error[candidates[smallest + 1]])) ? smallest - 1 : smallest + 1;
+            unsigned first = std::min(smallest, neighbour);
+            candidates.erase(candidates.begin() + first, candidates.begin() + first + 2);
+        }
+
+        if (std::equal(candidates.begin(), candidates.end(), extremal.begin()))
+            break;
+        extremal.assign(candidates.begin(), candidates.end());
+    }
+
+    // the taps around the center carry half of each cosine, and the gain
+    // at DC is made exact, as in the oversamplers of the caps library
+    double dc = 0;
+    for (unsigned k = 0; k < half; ++k)
+        dc += solution[k];
+    for (unsigned k = 0; k < half; ++k) {
+        float c = (float)(0.5 * solution[k] / dc);
+        kernel[half + k] = c;
+        kernel[half - 1 - k] = c;
+    }
+
+    return maxError;
+}
+
+unsigned findEquirippleTaps(const QuadrafuzzFilterSpec &spec, unsigned over, unsigned maxTaps)
+{
+    std::vector<float> kernel(maxTaps);
+    for (unsigned taps = 2 * over; taps <= maxTaps; taps += over) {
+        if (taps % 2 != 0)
+            continue;
+        if (designEquiripple(spec, over, taps, kernel.data()) < 0)
+            continue;
+        if (measureFilter(spec, over, kernel.data(), taps).meets(spec))
+            return taps;
+    }
+    return 0;
+}
+
+QuadrafuzzFilterResponse measureFilter(const QuadrafuzzFilterSpec &spec, unsigned over, const float *kernel, unsigned taps)
+{
+    const unsigned pointsPerRate = 2048;
+    QuadrafuzzFilterResponse response{0, HUGE_VAL, HUGE_VAL};
+
+    for (unsigned i = 0, n = over * pointsPerRate / 2; i <= n; ++i) {
+        double f = double(i) / pointsPerRate;
+        double gain = filterGain(over, kernel, taps, f);
+        if (f <= spec.passband)
+            response.ripple = std::max(response.ripple, std::fabs(gain));
+        else if (f >= spec.aliasband)
+            response.aliasAttenuation = std::min(response.aliasAttenuation, -gain);
+        else if (f >= spec.stopband)
+            response.stopAttenuation = std::min(response.stopAttenuation, -gain);
+    }
+
+    return response;
+}
+
+double filterGain(unsigned over, const float *kernel, unsigned taps, double frequency)
+{
+    // the phasor of each tap, by rotation
+    double w = 2 * M_PI * frequency / over;
+    double stepRe = std::cos(w), stepIm = -std::sin(w);
+    double phRe = 1, phIm = 0;
+    double re = 0, im = 0;
+    for (unsigned t = 0; t < taps; ++t) {
+        re += kernel[t] * phRe;
+        im += kernel[t] * phIm;
+        double nextRe = phRe * stepRe - phIm * stepIm;
+        phIm = phRe * stepIm + phIm * stepRe;
+        phRe = nextRe;
+    }
+    return 10 * std::log10(std::max(re * re + im * im, 1e-30));
+}
@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+/**
+ * The specification of the lowpass filter of an oversampler, which both
+ * the interpolator and the decimator use.
+ *
+ * The frequencies are fractions of the host sample rate. The stopband is
+ * split in two: from `stopband`, where the aliases of the decimator land
+ * above the passband, and from `aliasband`, where they fold back into it.
+ */
+struct QuadrafuzzFilterSpec {
+    double passband, stopband, aliasband;
+    /* the largest deviation in the passband, and the smallest attenuations
+       of the two parts of the stopband, in dB */
+    double ripple, stopAttenuation, aliasAttenuation;
+};
+
+/* the response of a filter, measured against the bands of a specification */
+struct QuadrafuzzFilterResponse {
+    double ripple, stopAttenuation, aliasAttenuation;
+
+    bool meets(const QuadrafuzzFilterSpec &spec) const;
+};
+
+/**
+ * Designs an equiripple lowpass filter of `taps` coefficients, an even
+ * number, for oversampling by `over`, by the exchange algorithm of Remez,
+ * as in the method of Parks and McClellan. The kernel has a linear phase.
+ * The error at DC weighs ten times the rest of the passband, so that the
+ * ripple stays within the tolerance once the gain at DC is made unity.
+ *
+ * Returns the largest error, weighted by the tolerances of the bands, which
+ * is at most 1 when the filter meets the specification, or a negative value
+ * if the exchange failed. It allocates, and must not run on the audio thread.
+ */
+double designEquiripple(const QuadrafuzzFilterSpec &spec, unsigned over, unsigned taps, float *kernel);
+
+/* the shortest multiple of `over` up to `maxTaps` whose design meets the
+   specification, or 0 if there is none */
+unsigned findEquirippleTaps(const QuadrafuzzFilterSpec &spec, unsigned over, unsigned maxTaps);
+
+/* the response of a kernel for oversampling by `over` */
+QuadrafuzzFilterResponse measureFilter(const QuadrafuzzFilterSpec &spec, unsigned over, const float *kernel, unsigned taps);
+
+/* the gain of a kernel in dB, at a fraction `frequency` of the host rate */
+double filterGain(unsigned over, const float *kernel, unsigned taps, double frequency);
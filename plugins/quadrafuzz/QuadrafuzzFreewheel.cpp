@@ -0,0 +1,72 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "QuadrafuzzFreewheel.hpp"
+
+bool QuadrafuzzFreewheel::process(uint32_t frames, double sampleRate)
+{
+    Clock::time_point now = Clock::now();
+
+    if (!fStarted) {
+        fStarted = true;
+        fWindowStart = now;
+        fWindowAudio = frames / sampleRate;
+        return fFreewheeling;
+    }
+
+    // the audio of the blocks before this one, against the time they took
+    double wall = std::chrono::duration<double>(now - fWindowStart).count();
+    double audio = fWindowAudio;
+
+    bool restart = false;
+    if (fFreewheeling) {
+        if (wall >= kLeaveTime) {
+            fFreewheeling = audio >= kLeaveSpeed * wall;
+            restart = true;
+        }
+    }
+    else if (audio >= kWindowTime || wall >= kWindowTime) {
+        fFastWindows = (audio >= kEnterSpeed * wall) ? fFastWindows + 1 : 0;
+        fFreewheeling = fFastWindows >= kEnterWindows;
+        restart = true;
+    }
+
+    if (restart) {
+        if (fFreewheeling)
+            fFastWindows = 0;
+        fWindowStart = now;
+        fWindowAudio = 0;
+    }
+    fWindowAudio += frames / sampleRate;
+
+    return fFreewheeling;
+}
+
+void QuadrafuzzFreewheel::reset()
+{
+    fFreewheeling = false;
+    fStarted = false;
+    fWindowAudio = 0;
+    fFastWindows = 0;
+}
@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Detection of offline rendering, from the pace of the blocks.
+ *
+ * A host which plays in real time asks for the blocks at the pace of the
+ * audio, and one which renders offline, or freewheels, asks for them as
+ * fast as it can. The detector compares the duration of the audio with the
+ * time it took to come, over windows of `kWindowTime` of audio.
+ *
+ * It enters offline rendering when the audio comes at least `kEnterSpeed`
+ * times as fast as real time over `kEnterWindows` windows in a row. A host
+ * which renders ahead in real time, to prebuffer or prefetch, runs ahead by
+ * its buffer at most, and would need a second of it to pass. Then the
+ * windows last `kLeaveTime` of time, and it leaves at the first where the
+ * audio comes slower than `kLeaveSpeed` times real time, so that the return
+ * to real time takes little of the heavy processing of offline rendering.
+ *
+ * The pace is a guess, so the plugin only detects it when the user asks.
+ */
+class QuadrafuzzFreewheel
+{
+public:
+    /* to call at the start of each block, tells whether it is offline */
+    bool process(uint32_t frames, double sampleRate);
+    bool isFreewheeling() const { return fFreewheeling; }
+
+    /* forgets the pace, when the processing restarts */
+    void reset();
+
+private:
+    static constexpr double kWindowTime = 500e-3;
+    static constexpr double kLeaveTime = 50e-3;
+    static constexpr double kEnterSpeed = 2;
+    static constexpr unsigned kEnterWindows = 4;
+    static constexpr double kLeaveSpeed = 1.25;
+
+    typedef std::chrono::steady_clock Clock;
+
+    bool fFreewheeling = false;
+    bool fStarted = false;
+    /* the start of the window, and the audio which came in it */
+    Clock::time_point fWindowStart;
+    double fWindowAudio = 0;
+    /* the windows in a row which came fast enough to enter */
+    unsigned fFastWindows = 0;
+};
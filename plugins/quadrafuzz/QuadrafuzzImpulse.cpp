@@ -0,0 +1,212 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "QuadrafuzzImpulse.hpp"
+#include <algorithm>
+#include <memory>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+enum {
+    kFormatPcm = 1,
+    kFormatFloat = 3,
+    kFormatExtensible = 0xfffe,
+};
+
+/* the zero crossings of the sinc on each side, at the lower of the rates */
+constexpr unsigned kSincZeros = 32;
+
+/* the samples which the reader keeps past the longest response, which the
+   sinc reaches at output rates down to 8 kHz, in seconds */
+constexpr double kResampleMarginTime = kSincZeros / 8000.0;
+
+/* the bytes of the format chunk which the reader uses, up to the format of
+   the extensible header */
+constexpr unsigned kFormatBytes = 26;
+
+/* the bytes which the reader takes from the data chunk at once */
+constexpr uint32_t kReadBytes = 65536;
+
+uint32_t readLE(const uint8_t *data, unsigned bytes)
+{
+    uint32_t value = 0;
+    for (unsigned i = 0; i < bytes; ++i)
+        value |= (uint32_t)data[i] << (8 * i);
+    return value;
+}
+
+struct FileCloser {
+    void operator()(FILE *file) const { fclose(file); }
+};
+
+/* a sample of `bytes` bytes, as a float from -1 to 1 */
+float decodeSample(const uint8_t *data, unsigned format, unsigned bytes)
+{
+    if (format == kFormatFloat) {
+        if (bytes == 4) {
+            uint32_t bits = readLE(data, 4);
+            float value;
+            memcpy(&value, &bits, 4);
+            return value;
+        }
+        uint64_t bits = readLE(data, 4) | (uint64_t)readLE(data + 4, 4) << 32;
+        double value;
+        memcpy(&value, &bits, 8);
+        return (float)value;
+    }
+
+    // 8 bits are unsigned, the other sizes are signed
+    if (bytes == 1)
+        return (data[0] - 128) * (1.0f / 128);
+    uint32_t bits = readLE(data, bytes) << (32 - 8 * bytes);
+    return (int32_t)bits * (1.0f / 2147483648.0f);
+}
+
+} // namespace
+
+bool readImpulseResponse(const char *path, std::vector<float> &samples, double &sampleRate)
+{
+    std::unique_ptr<FILE, FileCloser> file(fopen(path, "rb"));
+    if (!file) {
+        fprintf(stderr, "quadrafuzz: cannot open the impulse response \"%s\"\n", path);
+        return false;
+    }
+
+    uint8_t header[12];
+    if (fread(header, 1, 12, file.get()) != 12 || memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4)) {
+        fprintf(stderr, "quadrafuzz: the impulse response \"%s\" is not a WAV file\n", path);
+        return false;
+    }
+
+    unsigned format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    bool haveFormat = false;
+    uint32_t dataSize = 0;
+    bool haveData = false;
+
+    // the sizes in the header are not trusted, as a file which was streamed
+    // has none, and the reading stops at the end of the file
+    for (uint8_t chunk[8]; !haveData && fread(chunk, 1, 8, file.get()) == 8;) {
+        uint32_t size = readLE(chunk + 4, 4);
+        if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+            uint8_t fmt[kFormatBytes] = {};
+            uint32_t count = std::min<uint32_t>(size, kFormatBytes);
+            if (fread(fmt, 1, count, file.get()) != count)
+                break;
+            format = readLE(&fmt[0], 2);
+            channels = readLE(&fmt[2], 2);
+            rate = readLE(&fmt[4], 4);
+            bits = readLE(&fmt[14], 2);
+            if (format == kFormatExtensible && size >= 26)
+                format = readLE(&fmt[24], 2);
+            haveFormat = true;
+            if (fseek(file.get(), size - count, SEEK_CUR) != 0)
+                break;
+        }
+        else if (!memcmp(chunk, "data", 4) && haveFormat) {
+            dataSize = size;
+            haveData = true;
+        }
+        else if (fseek(file.get(), size, SEEK_CUR) != 0)
+            break;
+        // the chunks are aligned on two bytes
+        if ((size & 1) && !haveData)
+            fseek(file.get(), 1, SEEK_CUR);
+    }
+
+    unsigned bytes = bits / 8;
+    bool supported = (format == kFormatPcm && bits % 8 == 0 && bytes >= 1 && bytes <= 4) ||
+        (format == kFormatFloat && (bits == 32 || bits == 64));
+    if (!haveFormat || !supported || channels == 0 || rate == 0) {
+        fprintf(stderr, "quadrafuzz: the format of the impulse response \"%s\" is not supported\n", path);
+        return false;
+    }
+
+    // the samples past the longest response are not needed, and a truncated
+    // file keeps the samples which it has
+    uint32_t frameBytes = bytes * channels;
+    uint64_t frames = std::min<uint64_t>(dataSize / frameBytes,
+                                         (uint64_t)std::ceil((kMaxImpulseTime + kResampleMarginTime) * rate));
+    uint32_t blockFrames = std::max<uint32_t>(1, kReadBytes / frameBytes);
+    std::vector<uint8_t> block((size_t)blockFrames * frameBytes);
+    std::vector<float> decoded;
+    while (haveData && decoded.size() < frames) {
+        size_t count = (size_t)std::min<uint64_t>(blockFrames, frames - decoded.size());
+        size_t read = fread(block.data(), frameBytes, count, file.get());
+        for (size_t i = 0; i < read; ++i)
+            decoded.push_back(decodeSample(&block[i * frameBytes], format, bytes));
+        if (read < count)
+            break;
+    }
+
+    if (decoded.empty()) {
+        fprintf(stderr, "quadrafuzz: the impulse response \"%s\" has no samples\n", path);
+        return false;
+    }
+
+    samples.swap(decoded);
+    sampleRate = rate;
+    return true;
+}
+
+void resampleImpulseResponse(const std::vector<float> &input, double inputRate,
+                             std::vector<float> &output, double outputRate, uint32_t maxLength)
+{
+    const uint32_t inputLength = input.size();
+    uint32_t length = (uint32_t)std::ceil(inputLength * outputRate / inputRate);
+    length = std::min(length, maxLength);
+
+    if (inputRate == outputRate) {
+        output.assign(input.begin(), input.begin() + length);
+        return;
+    }
+
+    // the cutoff at the lower Nyquist frequency, relative to the input rate,
+    // and the gain which keeps the frequency response: the sum of the sinc
+    // is `1 / cutoff`, and the samples of the response are `step` times as
+    // many at the input rate
+    const double step = inputRate / outputRate;
+    const double cutoff = std::min(1.0, outputRate / inputRate);
+    const double halfWidth = kSincZeros / cutoff;
+    const double gain = step * cutoff;
+
+    output.resize(length);
+    for (uint32_t i = 0; i < length; ++i) {
+        double center = i * step;
+        int64_t first = std::max<int64_t>(0, (int64_t)std::ceil(center - halfWidth));
+        int64_t last = std::min<int64_t>(inputLength - 1, (int64_t)std::floor(center + halfWidth));
+        double sum = 0;
+        for (int64_t j = first; j <= last; ++j) {
+            double x = (j - center) * cutoff;
+            double sinc = (x == 0) ? 1 : std::sin(M_PI * x) / (M_PI * x);
+            // the window of Blackman over the width of the sinc
+            double w = 0.42 + 0.5 * std::cos(M_PI * x / kSincZeros) + 0.08 * std::cos(2 * M_PI * x / kSincZeros);
+            sum += input[j] * sinc * w;
+        }
+        output[i] = (float)(gain * sum);
+    }
+}
@@ -0,0 +1,51 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#pragma once
+#include <vector>
+#include <cstdint>
+
+/* the longest impulse response which the cabinet keeps, in seconds */
+static constexpr double kMaxImpulseTime = 2;
+
+/**
+ * Reads the first channel of a WAV file, for the impulse response of the
+ * cabinet: integer samples of 8 to 32 bits, and floating point samples of
+ * 32 or 64 bits, in the plain or the extensible format.
+ *
+ * Returns false, after a message on the standard error, if the file cannot
+ * be read or has no samples. It keeps the samples of `kMaxImpulseTime`, and
+ * the few past it which the resampling needs. It allocates and reads the
+ * file, and must not run on the audio thread.
+ */
+bool readImpulseResponse(const char *path, std::vector<float> &samples, double &sampleRate);
+
+/**
+ * Converts an impulse response to another sample rate by interpolation with
+ * a windowed sinc, which keeps its frequency response, and filters out what
+ * lies above the Nyquist frequency of a lower rate. The result is at most
+ * `maxLength` samples.
+ */
+void resampleImpulseResponse(const std::vector<float> &input, double inputRate,
+                             std::vector<float> &output, double outputRate, uint32_t maxLength);
@@ -0,0 +1,299 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "QuadrafuzzKernelCache.hpp"
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if !defined(_WIN32)
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct QuadrafuzzKernelCache::Key {
+    double spec[6];
+    uint32_t over, taps;
+};
+
+namespace {
+
+/* the layout of the file, in the byte order of the machine: the header,
+   the entries, then the coefficients of the kernels one after the other */
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+};
+
+struct FileEntry {
+    double spec[6];
+    uint32_t over, taps;
+    uint64_t offset;
+};
+
+static_assert(sizeof(FileHeader) == 16 && sizeof(FileEntry) == 64, "the layout of the file has padding");
+
+const char kMagic[8] = {'Q', 'F', 'Z', 'K', 'E', 'R', 'N', '\0'};
+
+/* the entries of a file, or null if it is not valid, or it is of another
+   version or byte order */
+const FileEntry *validEntries(const unsigned char *data, size_t size, uint32_t &count)
+{
+    count = 0;
+    if (!data || size < sizeof(FileHeader))
+        return nullptr;
+
+    FileHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != QuadrafuzzKernelCache::kVersion ||
+        header.count > (size - sizeof(FileHeader)) / sizeof(FileEntry))
+        return nullptr;
+
+    const FileEntry *entries = reinterpret_cast<const FileEntry *>(data + sizeof(FileHeader));
+    for (uint32_t i = 0; i < header.count; ++i) {
+        const FileEntry &entry = entries[i];
+        if (entry.offset % sizeof(float) != 0 || entry.offset > size ||
+            entry.taps > (size - entry.offset) / sizeof(float))
+            return nullptr;
+    }
+
+    count = header.count;
+    return entries;
+}
+
+#if !defined(_WIN32)
+/* creates the directories above a file, as needed */
+bool makeParentDirectories(const std::string &path)
+{
+    for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+        std::string dir = path.substr(0, pos);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+    }
+    return true;
+}
+#endif
+
+} // namespace
+
+QuadrafuzzKernelCache &QuadrafuzzKernelCache::get()
+{
+    static QuadrafuzzKernelCache cache([]() -> std::string {
+        const char *path = getenv("QUADRAFUZZ_KERNEL_CACHE");
+        return path ? std::string(path) : defaultPath();
+    }());
+    return cache;
+}
+
+std::string QuadrafuzzKernelCache::defaultPath()
+{
+    std::string dir;
+#if !defined(_WIN32)
+    const char *home = getenv("HOME");
+#if defined(__APPLE__)
+    if (home && home[0] == '/')
+        dir = std::string(home) + "/Library/Caches";
+#else
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && xdg[0] == '/')
+        dir = xdg;
+    else if (home && home[0] == '/')
+        dir = std::string(home) + "/.cache";
+#endif
+#endif
+    if (dir.empty())
+        return dir;
+    return dir + "/quadrafuzz/kernels-" + std::to_string(kVersion) + ".bin";
+}
+
+QuadrafuzzKernelCache::QuadrafuzzKernelCache(std::string path)
+    : fPath(std::move(path))
+{
+    map();
+}
+
+QuadrafuzzKernelCache::~QuadrafuzzKernelCache()
+{
+    unmap();
+}
+
+bool QuadrafuzzKernelCache::equiripple(const QuadrafuzzFilterSpec &spec, unsigned over, unsigned taps, float *kernel)
+{
+    const Key key {
+        {spec.passband, spec.stopband, spec.aliasband, spec.ripple, spec.stopAttenuation, spec.aliasAttenuation},
+        over, taps};
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (find(key, kernel))
+        return true;
+
+    // the lock of the file keeps the other processes from designing the
+    // same kernel, and one of them may have added it since it was mapped
+    int lockFd = -1;
+#if !defined(_WIN32)
+    if (!fPath.empty() && makeParentDirectories(fPath)) {
+        lockFd = open((fPath + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (lockFd != -1 && flock(lockFd, LOCK_EX) != 0) {
+            close(lockFd);
+            lockFd = -1;
+        }
+    }
+    if (lockFd != -1) {
+        map();
+        if (find(key, kernel)) {
+            close(lockFd);
+            return true;
+        }
+    }
+#endif
+
+    bool designed = designEquiripple(spec, over, taps, kernel) >= 0;
+    if (designed) {
+        ++fDesignCount;
+        if (lockFd != -1)
+            add(key, kernel);
+    }
+
+#if !defined(_WIN32)
+    if (lockFd != -1)
+        close(lockFd);
+#endif
+    return designed;
+}
+
+bool QuadrafuzzKernelCache::find(const Key &key, float *kernel) const
+{
+    uint32_t count;
+    const FileEntry *entries = validEntries(fData, fSize, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        FileEntry entry;
+        memcpy(&entry, &entries[i], sizeof(entry));
+        if (entry.over == key.over && entry.taps == key.taps &&
+            memcmp(entry.spec, key.spec, sizeof(key.spec)) == 0) {
+            memcpy(kernel, fData + entry.offset, key.taps * sizeof(float));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool QuadrafuzzKernelCache::add(const Key &key, const float *kernel)
+{
+#if defined(_WIN32)
+    (void)key;
+    (void)kernel;
+    return false;
+#else
+    // the kernels of the file, and the new one after them
+    uint32_t count;
+    const FileEntry *entries = validEntries(fData, fSize, count);
+    std::vector<FileEntry> newEntries(count + 1);
+    uint64_t offset = sizeof(FileHeader) + newEntries.size() * sizeof(FileEntry);
+    for (uint32_t i = 0; i <= count; ++i) {
+        FileEntry &entry = newEntries[i];
+        if (i < count)
+            memcpy(&entry, &entries[i], sizeof(entry));
+        else {
+            memcpy(entry.spec, key.spec, sizeof(key.spec));
+            entry.over = key.over;
+            entry.taps = key.taps;
+        }
+        entry.offset = offset;
+        offset += entry.taps * sizeof(float);
+    }
+
+    FileHeader header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.count = count + 1;
+
+    std::string tempPath = fPath + ".XXXXXX";
+    int fd = mkstemp(&tempPath[0]);
+    if (fd == -1)
+        return false;
+    FILE *stream = fdopen(fd, "wb");
+    if (!stream) {
+        close(fd);
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    fwrite(&header, sizeof(header), 1, stream);
+    fwrite(newEntries.data(), sizeof(FileEntry), newEntries.size(), stream);
+    for (uint32_t i = 0; i < count; ++i) {
+        FileEntry entry;
+        memcpy(&entry, &entries[i], sizeof(entry));
+        fwrite(fData + entry.offset, sizeof(float), entry.taps, stream);
+    }
+    fwrite(kernel, sizeof(float), key.taps, stream);
+
+    bool written = !ferror(stream);
+    written = (fclose(stream) == 0) && written;
+    if (!written || rename(tempPath.c_str(), fPath.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    map();
+    return true;
+#endif
+}
+
+void QuadrafuzzKernelCache::map()
+{
+    unmap();
+#if !defined(_WIN32)
+    if (fPath.empty())
+        return;
+    int fd = open(fPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            fData = static_cast<const unsigned char *>(data);
+            fSize = st.st_size;
+        }
+    }
+    close(fd);
+#endif
+}
+
+void QuadrafuzzKernelCache::unmap()
+{
+#if !defined(_WIN32)
+    if (fData)
+        munmap(const_cast<unsigned char *>(fData), fSize);
+#endif
+    fData = nullptr;
+    fSize = 0;
+}
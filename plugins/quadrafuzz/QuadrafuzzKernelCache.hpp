@@ -0,0 +1,87 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#pragma once
+#include "QuadrafuzzFilterDesign.hpp"
+#include <mutex>
+#include <string>
+#include <cstddef>
+
+/**
+ * A cache of the designed kernels, in a file which the processes of the
+ * user share, so that each kernel is designed once per specification, and
+ * then read from a read-only mapping of the file by every instance.
+ *
+ * The file lives in the cache directory of the user, as
+ * `quadrafuzz/kernels-<version>.bin`, or at the path which the environment
+ * variable `QUADRAFUZZ_KERNEL_CACHE` gives, and an empty path disables it.
+ * The version changes with the designer and the layout of the file, and a
+ * file whose header does not match is ignored, then replaced.
+ *
+ * The file is never written in place: a new kernel is added by writing a
+ * whole new file next to it and renaming it over the old one, under a lock,
+ * so the mappings of the other processes stay valid. Without a file, as on
+ * Windows, every kernel is designed.
+ *
+ * It allocates and does file I/O, and must not be used on the audio thread.
+ */
+class QuadrafuzzKernelCache
+{
+public:
+    enum { kVersion = 1 };
+
+    /* the cache of the process, at the path of the environment */
+    static QuadrafuzzKernelCache &get();
+
+    explicit QuadrafuzzKernelCache(std::string path);
+    ~QuadrafuzzKernelCache();
+
+    /* copies the kernel of `designEquiripple` into `kernel`, designing it
+       when the file does not have it; false if the design failed */
+    bool equiripple(const QuadrafuzzFilterSpec &spec, unsigned over, unsigned taps, float *kernel);
+
+    const std::string &path() const { return fPath; }
+    /* the number of kernels which were designed rather than read */
+    unsigned designCount() const { return fDesignCount; }
+
+    /* the default path in the cache directory of the user, or empty */
+    static std::string defaultPath();
+
+private:
+    struct Key;
+
+    bool find(const Key &key, float *kernel) const;
+    bool add(const Key &key, const float *kernel);
+    void map();
+    void unmap();
+
+    std::mutex fMutex;
+    std::string fPath;
+    const unsigned char *fData = nullptr;
+    size_t fSize = 0;
+    unsigned fDesignCount = 0;
+
+    QuadrafuzzKernelCache(const QuadrafuzzKernelCache &) = delete;
+    QuadrafuzzKernelCache &operator=(const QuadrafuzzKernelCache &) = delete;
+};
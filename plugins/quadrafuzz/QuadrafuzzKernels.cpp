@@ -0,0 +1,205 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "QuadrafuzzKernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#   define QUADRAFUZZ_KERNELS_X86 1
+#elif defined(__aarch64__)
+#   define QUADRAFUZZ_KERNELS_NEON 1
+#endif
+
+/* the reference, which the compiler must not vectorize */
+#define KERNELS_NAMESPACE Scalar
+#define KERNELS_NAME "scalar"
+#define KERNELS_TARGET
+#if defined(__clang__)
+#   define KERNELS_LOOP _Pragma("clang loop vectorize(disable) interleave(disable)")
+#else
+#   define KERNELS_LOOP
+#   pragma GCC push_options
+#   pragma GCC optimize("no-tree-loop-vectorize", "no-tree-slp-vectorize")
+#endif
+#include "QuadrafuzzKernelsImpl.hpp"
+#if !defined(__clang__)
+#   pragma GCC pop_options
+#endif
+#undef KERNELS_NAMESPACE
+#undef KERNELS_NAME
+#undef KERNELS_TARGET
+#undef KERNELS_LOOP
+
+#define KERNELS_LOOP
+
+#if QUADRAFUZZ_KERNELS_X86
+#define KERNELS_NAMESPACE SSE2
+#define KERNELS_NAME "sse2"
+#define KERNELS_TARGET __attribute__((target("sse2")))
+#include "QuadrafuzzKernelsImpl.hpp"
+#undef KERNELS_NAMESPACE
+#undef KERNELS_NAME
+#undef KERNELS_TARGET
+
+#define KERNELS_NAMESPACE AVX2
+#define KERNELS_NAME "avx2"
+#define KERNELS_TARGET __attribute__((target("avx2,fma")))
+#include "QuadrafuzzKernelsImpl.hpp"
+#undef KERNELS_NAMESPACE
+#undef KERNELS_NAME
+#undef KERNELS_TARGET
+
+#define KERNELS_NAMESPACE AVX512
+#define KERNELS_NAME "avx512"
+#if defined(__clang__)
+#   define KERNELS_TARGET __attribute__((target("avx512f,avx512vl,avx512dq,avx512bw,fma")))
+#else
+#   define KERNELS_TARGET __attribute__((target("avx512f,avx512vl,avx512dq,avx512bw,fma,prefer-vector-width=512")))
+#endif
+#include "QuadrafuzzKernelsImpl.hpp"
+#undef KERNELS_NAMESPACE
+#undef KERNELS_NAME
+#undef KERNELS_TARGET
+#endif
+
+#if QUADRAFUZZ_KERNELS_NEON
+#define KERNELS_NAMESPACE NEON
+#define KERNELS_NAME "neon"
+#define KERNELS_TARGET
+#include "QuadrafuzzKernelsImpl.hpp"
+#undef KERNELS_NAMESPACE
+#undef KERNELS_NAME
+#undef KERNELS_TARGET
+#endif
+
+#undef KERNELS_LOOP
+
+///
+struct KernelsEntry {
+    const QuadrafuzzKernels *kernels;
+    bool (*isSupported)();
+    bool automatic; /* if false, only selected when forced */
+};
+
+static bool alwaysSupported()
+{
+    return true;
+}
+
+#if QUADRAFUZZ_KERNELS_X86
+static bool supportsAVX2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static bool supportsAVX512()
+{
+    __builtin_cpu_init();
+    return supportsAVX2() && __builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq") &&
+        __builtin_cpu_supports("avx512bw");
+}
+
+static bool supportsSSE2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+#endif
+
+#if QUADRAFUZZ_KERNELS_NEON
+static bool supportsNEON()
+{
+#if defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+#else
+    return true;
+#endif
+}
+#endif
+
+/* in the order of preference; AVX-512 is hardly faster than AVX2 on
+   these short loops, and it can lower the clock of the core for the whole
+   host, so it must be forced */
+static const KernelsEntry kernelsEntries[] = {
+#if QUADRAFUZZ_KERNELS_X86
+    {&AVX512::kernels, &supportsAVX512, false},
+    {&AVX2::kernels, &supportsAVX2, true},
+    {&SSE2::kernels, &supportsSSE2, true},
+#endif
+#if QUADRAFUZZ_KERNELS_NEON
+    {&NEON::kernels, &supportsNEON, true},
+#endif
+    {&Scalar::kernels, &alwaysSupported, true},
+};
+
+const QuadrafuzzKernels &selectKernels()
+{
+    const char *forced = getenv("QUADRAFUZZ_FORCE_ISA");
+    if (forced && forced[0] != '\0') {
+        if (const QuadrafuzzKernels *kernels = findKernels(forced))
+            return *kernels;
+        fprintf(stderr, "quadrafuzz: the instruction set \"%s\" is not available\n", forced);
+    }
+
+    for (const KernelsEntry &entry : kernelsEntries) {
+        if (entry.automatic && entry.isSupported())
+            return *entry.kernels;
+    }
+
+    return Scalar::kernels;
+}
+
+const QuadrafuzzKernels *findKernels(const char *name)
+{
+    for (const KernelsEntry &entry : kernelsEntries) {
+        if (!strcmp(entry.kernels->name, name))
+            return entry.isSupported() ? entry.kernels : nullptr;
+    }
+    return nullptr;
+}
+
+const char *const *listKernels()
+{
+    static const char *const names[] = {
+#if QUADRAFUZZ_KERNELS_X86
+        "avx512", "avx2", "sse2",
+#endif
+#if QUADRAFUZZ_KERNELS_NEON
+        "neon",
+#endif
+        "scalar", nullptr,
+    };
+    return names;
+}
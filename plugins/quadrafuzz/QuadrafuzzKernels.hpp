@@ -0,0 +1,94 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#include <cstdint>
+
+/**
+ * The hot loops of the processing, compiled for several instruction sets.
+ *
+ * Each instruction set has its table of kernels, and `selectKernels` picks
+ * the preferred one which the CPU supports. The environment variable
+ * `QUADRAFUZZ_FORCE_ISA` overrides the choice with the name of a table,
+ * for benchmarks and checks. The scalar table is always available, and is
+ * the reference for the others.
+ */
+struct QuadrafuzzKernels {
+    /* four biquad filters, which process the same input together */
+    struct BiquadGroup {
+        enum { Lanes = 4 };
+        double b0[Lanes], b1[Lanes], b2[Lanes], a1[Lanes], a2[Lanes];
+        double x1[Lanes], x2[Lanes], y1[Lanes], y2[Lanes];
+    };
+
+    /* view of the state of a FIR filter of the caps library */
+    struct FirState {
+        enum { MaxTaps = 256 };
+        const float *c; /* coefficients */
+        float *x; /* history */
+        uint32_t taps; /* number of coefficients */
+        uint32_t mask; /* history length - 1 */
+        int *h; /* history index */
+    };
+
+    const char *name;
+
+    /* out = gain * in */
+    void (*scale)(float *out, const float *in, float gain, uint32_t frames);
+    void (*scaleRamp)(float *out, const float *in, const float *gain, uint32_t frames);
+    /* out += gain * in */
+    void (*multiplyAdd)(float *out, const float *in, float gain, uint32_t frames);
+    void (*multiplyAddRamp)(float *out, const float *in, const float *gain, uint32_t frames);
+    /* out = sum of the inputs */
+    void (*sum)(float *out, const float *const *in, unsigned count, uint32_t frames);
+    /* the energy of the input */
+    float (*sumSquares)(const float *in, uint32_t frames);
+
+    /* the waveshaper, with constant or linearly moving coefficients */
+    void (*distort)(float *inout, float gain, float scale, uint32_t frames);
+    void (*distortRamp)(float *inout, float gain, float scale, float gainStep, float scaleStep, uint32_t frames);
+
+    /* filters `in` into the outputs of the lanes of `count` groups, one per lane */
+    void (*biquadGroups)(BiquadGroup *groups, unsigned count, const float *in, float *const *out, uint32_t frames);
+
+    /* interpolates `frames` inputs into `over * frames` outputs */
+    void (*upsample)(const FirState &fir, uint32_t over, const float *in, float *out, uint32_t frames);
+    /* decimates `over * frames` inputs into `frames` outputs */
+    void (*downsample)(const FirState &fir, uint32_t over, const float *in, float *out, uint32_t frames);
+
+    /* the sum of `a[i] * b[i]` */
+    float (*dot)(const float *a, const float *b, uint32_t frames);
+    /* acc += a * b, for complex spectra of `bins` values, split into their
+       real and imaginary parts */
+    void (*spectrumMultiplyAdd)(float *accRe, float *accIm, const float *aRe, const float *aIm,
+                                const float *bRe, const float *bIm, uint32_t bins);
+};
+
+/* the kernels to use, according to the CPU and to `QUADRAFUZZ_FORCE_ISA` */
+const QuadrafuzzKernels &selectKernels();
+
+/* the kernels of the named instruction set, or null if unsupported */
+const QuadrafuzzKernels *findKernels(const char *name);
+
+/* the null-terminated list of the instruction sets which are built */
+const char *const *listKernels();
@@ -0,0 +1,358 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+ * Implementation of the kernels, included once per instruction set by
+ * QuadrafuzzKernels.cpp, with these definitions:
+ *
+ * - KERNELS_NAMESPACE: the namespace of this instruction set
+ * - KERNELS_NAME: the name of the table
+ * - KERNELS_TARGET: the function attributes which enable the instructions
+ * - KERNELS_LOOP: a prefix of the loops, to control their vectorization
+ */
+
+namespace KERNELS_NAMESPACE {
+
+typedef QuadrafuzzKernels::BiquadGroup BiquadGroup;
+typedef QuadrafuzzKernels::FirState FirState;
+
+KERNELS_TARGET
+static void scale(float *out, const float *in, float gain, uint32_t frames)
+{
+    KERNELS_LOOP
+    for (uint32_t i = 0; i < frames; ++i)
+        out[i] = gain * in[i];
+}
+
+KERNELS_TARGET
+static void scaleRamp(float *out, const float *in, const float *gain, uint32_t frames)
+{
+    KERNELS_LOOP
+    for (uint32_t i = 0; i < frames; ++i)
+        out[i] = gain[i] * in[i];
+}
+
+KERNELS_TARGET
+static void multiplyAdd(float *out, const float *in, float gain, uint32_t frames)
+{
+    KERNELS_LOOP
+    for (uint32_t i = 0; i < frames; ++i)
+        out[i] += gain * in[i];
+}
+
+KERNELS_TARGET
+static void multiplyAddRamp(float *out, const float *in, const float *gain, uint32_t frames)
+{
+    KERNELS_LOOP
+    for (uint32_t i = 0; i < frames; ++i)
+        out[i] += gain[i] * in[i];
+}
+
+KERNELS_TARGET
+static float sumSquares(const float *in, uint32_t frames)
+{
+    float sum = 0;
+    KERNELS_LOOP
+    for (uint32_t i = 0; i < frames; ++i)
+        sum += in[i] * in[i];
+    return sum;
+}
+
+KERNELS_TARGET
+static void sum(float *out, const float *const *in, unsigned count, uint32_t frames)
+{
+    const float *first = in[0];
+    KERNELS_LOOP
+    for (uint32_t i = 0; i < frames; ++i)
+        out[i] = first[i];
+
+    for (unsigned k = 1; k < count; ++k) {
+        const float *other = in[k];
+        KERNELS_LOOP
+        for (uint32_t i = 0; i < frames; ++i)
+            out[i] += other[i];
+    }
+}
+
+KERNELS_TARGET
+static void distort(float *inout, float gain, float scale, uint32_t frames)
+{
+    float pi = M_PI;
+
+    KERNELS_LOOP
+    for (uint32_t i = 0; i < frames; ++i) {
+        float x = inout[i];
+        x = scale * x / (pi + gain * std::fabs(x));
+        inout[i] = x;
+    }
+}
+
+KERNELS_TARGET
+static void distortRamp(float *inout, float gain, float scale, float gainStep, float scaleStep, uint32_t frames)
+{
+    float pi = M_PI;
+
+    KERNELS_LOOP
+    for (uint32_t i = 0; i < frames; ++i) {
+        float g = gain + i * gainStep;
+        float s = scale + i * scaleStep;
+        float x = inout[i];
+        x = s * x / (pi + g * std::fabs(x));
+        inout[i] = x;
+    }
+}
+
+template <unsigned Groups>
+KERNELS_TARGET
+static void biquadGroupsN(BiquadGroup *groups, const float *in, float *const *out, uint32_t frames)
+{
+    constexpr unsigned lanes = Groups * BiquadGroup::Lanes;
+
+    // the lanes are independent, to run in parallel
+    double b0[lanes], b1[lanes], b2[lanes], a1[lanes], a2[lanes];
+    double x1[lanes], x2[lanes], y1[lanes], y2[lanes];
+    for (unsigned l = 0; l < lanes; ++l) {
+        const BiquadGroup &group = groups[l / BiquadGroup::Lanes];
+        unsigned gl = l % BiquadGroup::Lanes;
+        b0[l] = group.b0[gl];
+        b1[l] = group.b1[gl];
+        b2[l] = group.b2[gl];
+        a1[l] = group.a1[gl];
+        a2[l] = group.a2[gl];
+        x1[l] = group.x1[gl];
+        x2[l] = group.x2[gl];
+        y1[l] = group.y1[gl];
+        y2[l] = group.y2[gl];
+    }
+
+    for (uint32_t i = 0; i < frames; ++i) {
+        double y[lanes];
+        for (unsigned l = 0; l < lanes; ++l) {
+            double x = in[i];
+            y[l] = b0[l] * x + b1[l] * x1[l] + b2[l] * x2[l] - a1[l] * y1[l] - a2[l] * y2[l];
+            x2[l] = x1[l];
+            x1[l] = x;
+            y2[l] = y1[l];
+            y1[l] = y[l];
+        }
+        for (unsigned l = 0; l < lanes; ++l)
+            out[l][i] = y[l];
+    }
+
+    // like WebCore::Biquad, flush the tail of silence to zero
+    for (unsigned l = 0; l < lanes; ++l) {
+        if (x1[l] == 0.0 && x2[l] == 0.0 && (y1[l] != 0.0 || y2[l] != 0.0) &&
+            std::fabs(y1[l]) < FLT_MIN && std::fabs(y2[l]) < FLT_MIN) {
+            y1[l] = y2[l] = 0.0;
+            float *dest = out[l];
+            for (uint32_t i = frames; i-- > 0 && std::fabs(dest[i]) < FLT_MIN;)
+                dest[i] = 0.0f;
+        }
+        BiquadGroup &group = groups[l / BiquadGroup::Lanes];
+        unsigned gl = l % BiquadGroup::Lanes;
+        group.x1[gl] = x1[l];
+        group.x2[gl] = x2[l];
+        group.y1[gl] = y1[l];
+        group.y2[gl] = y2[l];
+    }
+}
+
+KERNELS_TARGET
+static void biquadGroups(BiquadGroup *groups, unsigned count, const float *in, float *const *out, uint32_t frames)
+{
+    // pairs of groups, to hide the latency of the recurrence
+    for (; count >= 2; count -= 2, groups += 2, out += 2 * BiquadGroup::Lanes)
+        biquadGroupsN<2>(groups, in, out, frames);
+    if (count > 0)
+        biquadGroupsN<1>(groups, in, out, frames);
+}
+
+template <uint32_t Over>
+KERNELS_TARGET
+static void upsampleOver(const FirState &fir, const float *in, float *out, uint32_t frames)
+{
+    constexpr uint32_t block = 64;
+    const float *c = fir.c;
+    float *x = fir.x;
+    const uint32_t taps = fir.taps / Over;
+    const uint32_t m = fir.mask;
+    uint32_t h = *fir.h;
+    assert(taps <= QuadrafuzzKernels::FirState::MaxTaps);
+
+    // the history in order then the inputs, and the outputs of each phase
+    float line[QuadrafuzzKernels::FirState::MaxTaps - 1 + block];
+    float phases[Over][block];
+
+    for (uint32_t base = 0; base < frames; base += block) {
+        uint32_t n = std::min(block, frames - base);
+
+        for (uint32_t k = 0; k + 1 < taps; ++k)
+            line[k] = x[(h - (taps - 1) + k) & m];
+        for (uint32_t i = 0; i < n; ++i) {
+            line[taps - 1 + i] = x[h] = in[base + i];
+            h = (h + 1) & m;
+        }
+
+        for (uint32_t o = 0; o < Over; ++o) {
+            float *phase = phases[o];
+            KERNELS_LOOP
+            for (uint32_t i = 0; i < n; ++i)
+                phase[i] = 0;
+            for (uint32_t j = 0; j < taps; ++j) {
+                float cj = c[j * Over + o];
+                const float *src = &line[taps - 1 - j];
+                KERNELS_LOOP
+                for (uint32_t i = 0; i < n; ++i)
+                    phase[i] += cj * src[i];
+            }
+        }
+
+        float *dest = &out[Over * base];
+        for (uint32_t i = 0; i < n; ++i) {
+            for (uint32_t o = 0; o < Over; ++o)
+                dest[Over * i + o] = phases[o][i];
+        }
+    }
+
+    *fir.h = h;
+}
+
+template <uint32_t Over>
+KERNELS_TARGET
+static void downsampleOver(const FirState &fir, const float *in, float *out, uint32_t frames)
+{
+    constexpr uint32_t block = 64;
+    const float *c = fir.c;
+    float *x = fir.x;
+    const uint32_t taps = fir.taps;
+    const uint32_t m = fir.mask;
+    uint32_t h = *fir.h;
+    assert(taps <= QuadrafuzzKernels::FirState::MaxTaps);
+
+    // the history in order then the inputs
+    float line[QuadrafuzzKernels::FirState::MaxTaps - 1 + Over * block];
+
+    for (uint32_t base = 0; base < frames; base += block) {
+        uint32_t n = std::min(block, frames - base);
+
+        for (uint32_t k = 0; k + 1 < taps; ++k)
+            line[k] = x[(h - (taps - 1) + k) & m];
+        for (uint32_t i = 0; i < Over * n; ++i) {
+            line[taps - 1 + i] = x[h] = in[Over * base + i];
+            h = (h + 1) & m;
+        }
+
+        for (uint32_t i = 0; i < n; ++i) {
+            const float *src = &line[taps - 1 + Over * i];
+            float s = 0;
+            KERNELS_LOOP
+            for (uint32_t z = 0; z < taps; ++z)
+                s += c[z] * src[-(int32_t)z];
+            out[base + i] = s;
+        }
+    }
+
+    *fir.h = h;
+}
+
+KERNELS_TARGET
+static void upsample(const FirState &fir, uint32_t over, const float *in, float *out, uint32_t frames)
+{
+    switch (over) {
+    case 2:
+        upsampleOver<2>(fir, in, out, frames);
+        break;
+    case 4:
+        upsampleOver<4>(fir, in, out, frames);
+        break;
+    case 8:
+        upsampleOver<8>(fir, in, out, frames);
+        break;
+    case 16:
+        upsampleOver<16>(fir, in, out, frames);
+        break;
+    default:
+        assert(false);
+    }
+}
+
+KERNELS_TARGET
+static void downsample(const FirState &fir, uint32_t over, const float *in, float *out, uint32_t frames)
+{
+    switch (over) {
+    case 2:
+        downsampleOver<2>(fir, in, out, frames);
+        break;
+    case 4:
+        downsampleOver<4>(fir, in, out, frames);
+        break;
+    case 8:
+        downsampleOver<8>(fir, in, out, frames);
+        break;
+    case 16:
+        downsampleOver<16>(fir, in, out, frames);
+        break;
+    default:
+        assert(false);
+    }
+}
+
+KERNELS_TARGET
+static float dot(const float *a, const float *b, uint32_t frames)
+{
+    float sum = 0;
+    KERNELS_LOOP
+    for (uint32_t i = 0; i < frames; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+KERNELS_TARGET
+static void spectrumMultiplyAdd(float *accRe, float *accIm, const float *aRe, const float *aIm,
+                                const float *bRe, const float *bIm, uint32_t bins)
+{
+    KERNELS_LOOP
+    for (uint32_t i = 0; i < bins; ++i) {
+        accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+        accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+    }
+}
+
+static const QuadrafuzzKernels kernels = {
+    KERNELS_NAME,
+    &scale,
+    &scaleRamp,
+    &multiplyAdd,
+    &multiplyAddRamp,
+    &sum,
+    &sumSquares,
+    &distort,
+    &distortRamp,
+    &biquadGroups,
+    &upsample,
+    &downsample,
+    &dot,
+    &spectrumMultiplyAdd,
+};
+
+} // namespace KERNELS_NAMESPACE
@@ -0,0 +1,169 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "QuadrafuzzPipeline.hpp"
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#   include <xmmintrin.h>
+#endif
+
+/* a hint to the CPU that the thread spins */
+static inline void relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#elif defined(_M_IX86) || defined(_M_X64)
+    _mm_pause();
+#endif
+}
+
+/* the control word of the floating point unit, with the flush of denormals */
+static inline uint64_t getFloatMode()
+{
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    return _mm_getcsr();
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    return fpcr;
+#else
+    return 0;
+#endif
+}
+
+static inline void setFloatMode(uint64_t mode)
+{
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    _mm_setcsr((unsigned)mode);
+#elif defined(__aarch64__)
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(mode));
+#else
+    (void)mode;
+#endif
+}
+
+QuadrafuzzPipeline::QuadrafuzzPipeline()
+{
+    fThread = std::thread([this]() { process(); });
+}
+
+QuadrafuzzPipeline::~QuadrafuzzPipeline()
+{
+    fQuit.store(true, std::memory_order_release);
+    fWake.post();
+    fThread.join();
+}
+
+void QuadrafuzzPipeline::post(Function function, void *data)
+{
+    fFunction = function;
+    fData = data;
+    fFloatMode = getFloatMode();
+    if (!fHasPoster.load(std::memory_order_relaxed)) {
+#if !defined(_WIN32)
+        fPoster = pthread_self();
+#else
+        fPosterPriority = GetThreadPriority(GetCurrentThread());
+#endif
+        fHasPoster.store(true, std::memory_order_release);
+    }
+    fState.store(kPosted, std::memory_order_release);
+    fWake.post();
+}
+
+void QuadrafuzzPipeline::wait()
+{
+    if (claim()) {
+        ++fTakenJobs;
+        runJob();
+        return;
+    }
+    while (fState.load(std::memory_order_acquire) != kIdle)
+        relax();
+}
+
+bool QuadrafuzzPipeline::claim()
+{
+    int expected = kPosted;
+    return fState.compare_exchange_strong(expected, kRunning, std::memory_order_acquire, std::memory_order_relaxed);
+}
+
+void QuadrafuzzPipeline::runJob()
+{
+    fFunction(fData);
+    fState.store(kIdle, std::memory_order_release);
+}
+
+void QuadrafuzzPipeline::process()
+{
+    // a post for a job which the audio thread took already wakes it for
+    // nothing, and it sleeps again
+    for (;;) {
+        fWake.wait();
+        if (fQuit.load(std::memory_order_acquire))
+            break;
+        followPriority();
+        if (!fLowerPriority.load(std::memory_order_relaxed) && claim()) {
+            // the host may flush denormals on the audio thread, and the job
+            // must give the same result on either thread
+            if (getFloatMode() != fFloatMode)
+                setFloatMode(fFloatMode);
+            runJob();
+        }
+    }
+}
+
+void QuadrafuzzPipeline::followPriority()
+{
+    if (fFollowing || !fHasPoster.load(std::memory_order_acquire))
+        return;
+    fFollowing = true;
+
+#if !defined(_WIN32)
+    // without the right to a real-time policy, it stays as it is, and lower
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(fPoster, &policy, &param) != 0 || policy == SCHED_OTHER)
+        return;
+    pthread_setschedparam(pthread_self(), policy, &param);
+
+    int ownPolicy;
+    sched_param ownParam;
+    if (pthread_getschedparam(pthread_self(), &ownPolicy, &ownParam) != 0 ||
+        ownPolicy != policy || ownParam.sched_priority < param.sched_priority)
+        fLowerPriority.store(true, std::memory_order_relaxed);
+#else
+    // the priorities above normal, like the ones which audio threads get
+    int priority = fPosterPriority;
+    if (priority <= THREAD_PRIORITY_NORMAL)
+        return;
+    SetThreadPriority(GetCurrentThread(), priority);
+    if (GetThreadPriority(GetCurrentThread()) < priority)
+        fLowerPriority.store(true, std::memory_order_relaxed);
+#endif
+}
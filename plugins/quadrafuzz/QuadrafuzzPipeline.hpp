@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#include "Semaphore.hpp"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#if !defined(_WIN32)
+#   include <pthread.h>
+#endif
+
+/**
+ * A helper thread which runs one stage of the processing of an instance,
+ * while the audio thread runs another one.
+ *
+ * The audio thread posts a job, and waits for it before it posts the next
+ * one. Posting and waiting are real-time safe: the job goes through an
+ * atomic state, and the helper is woken by a semaphore, which does not lock
+ * and only enters the kernel if the helper sleeps. A wake-up which is
+ * missed, or a helper which is not scheduled in time, costs parallelism
+ * and not correctness: if the helper has not started the job by the time
+ * the audio thread waits for it, the audio thread takes it and runs it
+ * itself; if the helper has started it, the audio thread spins until it
+ * ends.
+ *
+ * The helper takes the scheduling policy and the priority of the audio
+ * thread which posts to it, where the system allows it, and its floating
+ * point mode, so that denormals are flushed alike. The spin is not bounded,
+ * so if the poster is real-time and the helper could not follow it, the
+ * helper takes no job, since the audio thread could spin on one which the
+ * helper started and then lost the CPU for; the audio thread runs them all
+ * and the owner should stop posting, as told by `isLowerPriority`.
+ *
+ * It starts its thread at construction, which must not happen on the audio
+ * thread, and joins it at destruction, when no job is pending.
+ */
+class QuadrafuzzPipeline
+{
+public:
+    typedef void (*Function)(void *data);
+
+    QuadrafuzzPipeline();
+    ~QuadrafuzzPipeline();
+
+    /* runs `function` on the helper, with no other job pending */
+    void post(Function function, void *data);
+
+    /* waits for the pending job, if any, or runs it on the calling thread
+       if the helper has not started it */
+    void wait();
+
+    bool isPending() const { return fState.load(std::memory_order_acquire) != kIdle; }
+
+    /* whether the helper could not take the real-time priority of the
+       poster, so that it takes no job */
+    bool isLowerPriority() const { return fLowerPriority.load(std::memory_order_relaxed); }
+
+    /* how many jobs the audio thread took, since the construction */
+    unsigned getTakenJobs() const { return fTakenJobs; }
+
+private:
+    enum State { kIdle, kPosted, kRunning };
+
+    void process();
+    bool claim();
+    void runJob();
+    void followPriority();
+
+    std::atomic<int> fState{kIdle};
+    Function fFunction = nullptr;
+    void *fData = nullptr;
+    /* the floating point mode of the poster, which the helper takes */
+    uint64_t fFloatMode = 0;
+    unsigned fTakenJobs = 0;
+
+    /* the audio thread which posted first, whose priority the helper takes */
+#if !defined(_WIN32)
+    pthread_t fPoster {};
+#else
+    int fPosterPriority = 0;
+#endif
+    std::atomic<bool> fHasPoster{false};
+    bool fFollowing = false;
+    std::atomic<bool> fLowerPriority{false};
+
+    Semaphore fWake;
+    std::atomic<bool> fQuit{false};
+    std::thread fThread;
+
+    QuadrafuzzPipeline(const QuadrafuzzPipeline &) = delete;
+    QuadrafuzzPipeline &operator=(const QuadrafuzzPipeline &) = delete;
+};
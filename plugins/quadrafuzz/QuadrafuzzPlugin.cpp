@@ -21,12 +21,15 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #include "QuadrafuzzPlugin.hpp"
-#include <array>
-#include <cmath>
+#include <cstdio>
+#include <cstring>
 
 QuadrafuzzPlugin::QuadrafuzzPlugin()
     : Plugin(Parameter_Count, DISTRHO_PLUGIN_NUM_PROGRAMS, State_Count)
 {
+    fDSP.setSampleRate(getSampleRate());
+    fDSP.setBlockSize(getBufferSize());
+
     for (unsigned p = 0; p < Parameter_Count; ++p) {
         Parameter param;
         initParameter(p, param);
@@ -69,17 +72,35 @@ int64_t QuadrafuzzPlugin::getUniqueId() const
     return d_cconst(DISTRHO_PLUGIN_UNIQUE_ID);
 }
 
-static constexpr std::array<std::pair<int, const char *>, 4> OversamplingValues {{
-    {1, "none"},
-    {2, "2x"},
-    {4, "4x"},
-    {8, "8x"},
-}};
-
 void QuadrafuzzPlugin::initParameter(uint32_t index, Parameter &parameter)
 {
     parameter.hints = kParameterIsAutomable;
 
+    if (index >= pIdDrive && index < pIdDrive + QuadrafuzzDSP::Bands) {
+        const QuadrafuzzBand &band = QuadrafuzzDSP::getBand(index - pIdDrive);
+        initBandParameter(parameter, band, "Drive");
+        parameter.ranges = ParameterRanges(band.drive, 0.0, 1.0);
+        return;
+    }
+    if (index >= pIdMute && index < pIdMute + QuadrafuzzDSP::Bands) {
+        initBandParameter(parameter, QuadrafuzzDSP::getBand(index - pIdMute), "Mute");
+        parameter.ranges = ParameterRanges(0, 0, 1);
+        parameter.hints |= kParameterIsBoolean;
+        return;
+    }
+    if (index >= pIdSolo && index < pIdSolo + QuadrafuzzDSP::Bands) {
+        initBandParameter(parameter, QuadrafuzzDSP::getBand(index - pIdSolo), "Solo");
+        parameter.ranges = ParameterRanges(0, 0, 1);
+        parameter.hints |= kParameterIsBoolean;
+        return;
+    }
+    if (index >= pIdActivity && index < pIdActivity + QuadrafuzzDSP::Bands) {
+        initBandParameter(parameter, QuadrafuzzDSP::getBand(index - pIdActivity), "Active");
+        parameter.ranges = ParameterRanges(0, 0, 1);
+        parameter.hints = kParameterIsOutput | kParameterIsBoolean;
+        return;
+    }
+
     switch (index) {
     case pIdBypass:
         parameter.initDesignation(kParameterDesignationBypass);
@@ -108,26 +129,6 @@ void QuadrafuzzPlugin::initParameter(uint32_t index, Parameter &parameter)
         parameter.unit = "dB";
         parameter.ranges = ParameterRanges(0, -40, +10);
         break;
-    case pIdLowDrive:
-        parameter.symbol = "LowDrive";
-        parameter.name = "Low Drive";
-        parameter.ranges = ParameterRanges(0.6, 0.0, 1.0);
-        break;
-    case pIdMidLowDrive:
-        parameter.symbol = "MidLowDrive";
-        parameter.name = "Mid-Low Drive";
-        parameter.ranges = ParameterRanges(0.8, 0.0, 1.0);
-        break;
-    case pIdMidHighDrive:
-        parameter.symbol = "MidHighDrive";
-        parameter.name = "Mid-High Drive";
-        parameter.ranges = ParameterRanges(0.5, 0.0, 1.0);
-        break;
-    case pIdHighDrive:
-        parameter.symbol = "HighDrive";
-        parameter.name = "High Drive";
-        parameter.ranges = ParameterRanges(0.6, 0.0, 1.0);
-        break;
     case pIdOversampling: {
         ParameterEnumerationValue *enumValues =
             new ParameterEnumerationValue[OversamplingValues.size()];
@@ -140,228 +141,130 @@ void QuadrafuzzPlugin::initParameter(uint32_t index, Parameter &parameter)
         }
         parameter.symbol = "Oversampling";
         parameter.name = "Oversampling";
-        parameter.ranges = ParameterRanges(1, 1, OversamplingValues.back().first);
+        parameter.ranges = ParameterRanges(1, OversamplingValues.front().first, OversamplingValues.back().first);
         parameter.hints = kParameterIsInteger;
         break;
     }
-    default:
-        DISTRHO_SAFE_ASSERT(false);
-    }
-}
-
-float QuadrafuzzPlugin::getParameterValue(uint32_t index) const
-{
-    switch (index) {
-    case pIdBypass:
-        return fBypass;
-    case pIdInputGain:
-        return fInputGain;
-    case pIdOutputGain:
-        return fOutputGain;
-    case pIdDryGain:
-        return fDryGain;
-    case pIdWetGain:
-        return fWetGain;
-    case pIdLowDrive:
-        return fLowDrive;
-    case pIdMidLowDrive:
-        return fMidLowDrive;
-    case pIdMidHighDrive:
-        return fMidHighDrive;
-    case pIdHighDrive:
-        return fHighDrive;
-    case pIdOversampling:
-        return fOversampling;
-    default:
-        DISTRHO_SAFE_ASSERT_RETURN(false, 0);
-    }
-}
-
-void QuadrafuzzPlugin::setParameterValue(uint32_t index, float value)
-{
-    switch (index) {
-    case pIdBypass:
-        fBypass = value > 0.5f;
-        break;
-    case pIdInputGain:
-        fInputGain = value;
-        fInputGainLin = std::pow(10.0f, 0.05f * value);
+    case pIdDspLoad:
+        parameter.symbol = "DspLoad";
+        parameter.name = "DSP Load";
+        parameter.unit = "%";
+        parameter.ranges = ParameterRanges(0, 0, 100);
+        parameter.hints = kParameterIsOutput;
         break;
-    case pIdOutputGain:
-        fOutputGain = value;
-        fOutputGainLin = std::pow(10.0f, 0.05f * value);
-        break;
-    case pIdDryGain:
-        fDryGain = value;
-        fDryGainLin = std::pow(10.0f, 0.05f * value);
+    case pIdDspLoadPeak:
+        parameter.symbol = "DspLoadPeak";
+        parameter.name = "DSP Load Peak";
+        parameter.unit = "%";
+        parameter.ranges = ParameterRanges(0, 0, 100);
+        parameter.hints = kParameterIsOutput;
         break;
-    case pIdWetGain:
-        fWetGain = value;
-        fWetGainLin = std::pow(10.0f, 0.05f * value);
-        break;
-    case pIdLowDrive:
-        fLowDrive = value;
-        break;
-    case pIdMidLowDrive:
-        fMidLowDrive = value;
-        break;
-    case pIdMidHighDrive:
-        fMidHighDrive = value;
+    case pIdAliasBudget:
+        parameter.symbol = "AliasBudget";
+        parameter.name = "Alias Budget";
+        parameter.unit = "dB";
+        parameter.ranges = ParameterRanges(-80, -120, -40);
         break;
-    case pIdHighDrive:
-        fHighDrive = value;
+    case pIdCpuBudget:
+        parameter.symbol = "CpuBudget";
+        parameter.name = "CPU Budget";
+        parameter.unit = "%";
+        parameter.ranges = ParameterRanges(0, 0, 100);
         break;
-    case pIdOversampling:
-    {
-        unsigned o;
-        unsigned index = OversamplingValues.size() - 1;
-        do
-            o = OversamplingValues[index].first;
-        while (value < o && index-- > 0);
-        fOversampling = o;
+    case pIdEffectiveOversampling:
+        parameter.symbol = "EffectiveOversampling";
+        parameter.name = "Effective Oversampling";
+        parameter.ranges = ParameterRanges(1, 1, OversamplingValues.back().first);
+        parameter.hints = kParameterIsOutput | kParameterIsInteger;
         break;
-    }
     default:
         DISTRHO_SAFE_ASSERT(false);
     }
 }
 
-void QuadrafuzzPlugin::run(const float *inputs[], float *outputs[], uint32_t frames)
+void QuadrafuzzPlugin::initBandParameter(Parameter &parameter, const QuadrafuzzBand &band, const char *kind)
 {
-    switch (fOversampling) {
-    default:
-        DISTRHO_SAFE_ASSERT(false);
-        /* fall through */
-    case 1:
-        runWithoutOversampler(inputs, outputs, frames);
-        break;
-    case 2:
-        runWithOversampler(fOver2x, inputs, outputs, frames);
-        break;
-    case 4:
-        runWithOversampler(fOver4x, inputs, outputs, frames);
-        break;
-    case 8:
-        runWithOversampler(fOver8x, inputs, outputs, frames);
-        break;
-    }
+    char text[64];
+    std::snprintf(text, sizeof(text), "%s%s", band.symbol, kind);
+    parameter.symbol = text;
+    std::snprintf(text, sizeof(text), "%s %s", band.name, kind);
+    parameter.name = text;
 }
 
-template <class Oversampler> void QuadrafuzzPlugin::runWithOversampler(Oversampler &os, const float *inputs[], float *outputs[], uint32_t frames)
+float QuadrafuzzPlugin::getParameterValue(uint32_t index) const
 {
-    const float *input = inputs[0];
-    float *output = outputs[0];
+    DISTRHO_SAFE_ASSERT_RETURN(index < Parameter_Count, 0);
 
-    if (fBypass) {
-        memcpy(output, input, frames * sizeof(float));
-        return;
-    }
-
-    constexpr uint32_t over = Oversampler::Ratio;
-    if (fActiveOversampling != over) {
-        setupFilters(over);
-        fActiveOversampling = over;
-    }
-
-    float inputGain = fInputGainLin;
-    float outputGain = fOutputGainLin;
-    float dryGain = fDryGainLin;
-    float wetGain = fWetGainLin;
-    float drive[Bands] = { fLowDrive, fMidLowDrive, fMidHighDrive, fHighDrive };
-
-    constexpr uint32_t maxFrames = 64;
-
-    while (frames > 0) {
-        uint32_t framesCurrent = (frames < maxFrames) ? frames : maxFrames;
+    return fDSP.getParameterValue(index);
+}
 
-        // add dry signal
-        for (uint32_t i = 0; i < framesCurrent; ++i) {
-            float in = inputGain * input[i];
-            output[i] = dryGain * in;
-        }
+void QuadrafuzzPlugin::setParameterValue(uint32_t index, float value)
+{
+    DISTRHO_SAFE_ASSERT_RETURN(index < Parameter_Count, );
 
-        // compute oversampled input
-        float bandIn[maxFrames * over];
-        for (uint32_t i = 0; i < framesCurrent; ++i) {
-            bandIn[over * i] = os.upsample(wetGain * inputGain * input[i]);
-            for (uint32_t o = 1; o < over; ++o)
-                bandIn[over * i + o] = os.uppad(o);
-        }
+    fDSP.setParameterValue(index, value);
+}
 
-        // compute oversampled output
-        float bandOut[Bands][maxFrames * over];
-        for (unsigned b = 0; b < Bands; ++b) {
-            fBiquad[b].process(bandIn, bandOut[b], over * framesCurrent);
-            distort(bandOut[b], drive[b], over * framesCurrent);
-        }
-        for (uint32_t i = 0; i < framesCurrent; ++i) {
-            float sumBands = 0;
-            for (unsigned b = 0; b < Bands; ++b)
-                sumBands += bandOut[b][over * i];
-            output[i] += outputGain * os.downsample(sumBands);
-            for (uint32_t o = 1; o < over; ++o) {
-                sumBands = 0;
-                for (unsigned b = 0; b < Bands; ++b)
-                    sumBands += bandOut[b][over * i + o];
-                os.downstore(sumBands);
-            }
-        }
+void QuadrafuzzPlugin::initState(uint32_t index, String &stateKey, String &defaultStateValue)
+{
+    DISTRHO_SAFE_ASSERT_RETURN(index < State_Count, );
 
-        input += framesCurrent;
-        output += framesCurrent;
-        frames -= framesCurrent;
+    switch (index) {
+    case sIdImpulseResponse:
+        stateKey = "ImpulseResponse";
+        defaultStateValue = "";
+        break;
+    case sIdPipeline:
+        stateKey = "Pipeline";
+        defaultStateValue = "0";
+        break;
+    case sIdOfflineDetection:
+        stateKey = "OfflineDetection";
+        defaultStateValue = "0";
+        break;
     }
 }
 
-void QuadrafuzzPlugin::runWithoutOversampler(const float *inputs[], float *outputs[], uint32_t frames)
+void QuadrafuzzPlugin::setState(const char *key, const char *value)
 {
-    DSP::NoOversampler os;
-    runWithOversampler(os, inputs, outputs, frames);
+    if (!std::strcmp(key, "ImpulseResponse"))
+        fDSP.loadImpulseResponse(value);
+    else if (!std::strcmp(key, "Pipeline"))
+        fDSP.setPipelined(!std::strcmp(value, "1"));
+    else if (!std::strcmp(key, "OfflineDetection"))
+        fOfflineDetection.store(!std::strcmp(value, "1"), std::memory_order_relaxed);
 }
 
-void QuadrafuzzPlugin::setupFilters(unsigned over)
+void QuadrafuzzPlugin::activate()
 {
-    double fs = getSampleRate() * over;
-    double fnorm = 1.0 / (0.5 * fs);
-
-    fBiquad[0].setLowpassParams(147.0 * fnorm, M_SQRT1_2);
-    fBiquad[1].setBandpassParams(587.0 * fnorm, M_SQRT1_2);
-    fBiquad[2].setBandpassParams(2490.0 * fnorm, M_SQRT1_2);
-    fBiquad[3].setHighpassParams(4980.0 * fnorm, M_SQRT1_2);
-
-    for (unsigned nf = 0; nf < 4; ++nf) {
-        WebCore::Biquad &filter = fBiquad[nf];
-        filter.reset();
-    }
+    fDSP.setSampleRate(getSampleRate());
+    fDSP.setBlockSize(getBufferSize());
+    fFreewheel.reset();
+}
 
-    switch (over) {
-    default:
-        DISTRHO_SAFE_ASSERT(false);
-        /* fall through */
-    case 1:
-        break;
-    case 2:
-        fOver2x.reset();
-        break;
-    case 4:
-        fOver4x.reset();
-        break;
-    case 8:
-        fOver8x.reset();
-        break;
+void QuadrafuzzPlugin::run(const float *inputs[], float *outputs[], uint32_t frames)
+{
+    // DPF does not tell when the host renders offline, it is guessed from
+    // the pace, if the user asks for it
+    bool detect = fOfflineDetection.load(std::memory_order_relaxed);
+    if (detect != fDetecting) {
+        fFreewheel.reset();
+        fDetecting = detect;
     }
+    fDSP.setOffline(detect && fFreewheel.process(frames, getSampleRate()));
+    fDSP.run(inputs[0], outputs[0], frames);
+    // the pipeline delays the output by one chunk, once its memory is adopted
+    setLatency(fDSP.getLatency());
 }
 
-void QuadrafuzzPlugin::distort(float *inout, float gain, uint32_t frames)
+void QuadrafuzzPlugin::bufferSizeChanged(uint32_t newBufferSize)
 {
-    float pi = M_PI;
-    gain *= 150;
+    fDSP.setBlockSize(newBufferSize);
+}
 
-    for (uint32_t i = 0; i < frames; ++i) {
-        float x = inout[i];
-        x = (3 + gain) * (20 * pi / 180.0) * x / (pi + gain * std::fabs(x));
-        inout[i] = x;
-    }
+void QuadrafuzzPlugin::sampleRateChanged(double newSampleRate)
+{
+    fDSP.setSampleRate(newSampleRate);
 }
 
 ///
@@ -22,9 +22,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
 #include "DistrhoPlugin.hpp"
-#include "blink/Biquad.h"
-#include "caps/basics.h"
-#include "caps/dsp/Oversampler.h"
+#include "QuadrafuzzDSP.hpp"
+#include "QuadrafuzzFreewheel.hpp"
+#include <atomic>
 
 class QuadrafuzzPlugin : public DISTRHO::Plugin
 {
@@ -43,36 +43,22 @@ public:
     float getParameterValue(uint32_t index) const override;
     void setParameterValue(uint32_t index, float value) override;
 
+    void initState(uint32_t index, String &stateKey, String &defaultStateValue) override;
+    void setState(const char *key, const char *value) override;
+
+    void activate() override;
     void run(const float *inputs[], float *outputs[], uint32_t frames) override;
+    void bufferSizeChanged(uint32_t newBufferSize) override;
+    void sampleRateChanged(double newSampleRate) override;
 
 private:
-    template <class Oversampler> void runWithOversampler(Oversampler &os, const float *inputs[], float *outputs[], uint32_t frames);
-    void runWithoutOversampler(const float *inputs[], float *outputs[], uint32_t frames);
-    void setupFilters(unsigned over);
-    void distort(float *inout, float gain, uint32_t frames);
+    static void initBandParameter(Parameter &parameter, const QuadrafuzzBand &band, const char *kind);
 
 private:
-    bool fBypass = false;
-    unsigned fOversampling = 0;
-    float fInputGain = 0;
-    float fInputGainLin = 0;
-    float fOutputGain = 0;
-    float fOutputGainLin = 0;
-    float fDryGain = 0;
-    float fDryGainLin = 0;
-    float fWetGain = 0;
-    float fWetGainLin = 0;
-    float fLowDrive = 0;
-    float fMidLowDrive = 0;
-    float fMidHighDrive = 0;
-    float fHighDrive = 0;
-
-    unsigned fActiveOversampling = 0;
-
-    enum { Bands = 4 };
-
-    WebCore::Biquad fBiquad[Bands];
-    DSP::Oversampler<2, 32> fOver2x;
-    DSP::Oversampler<4, 64> fOver4x;
-    DSP::Oversampler<8, 64> fOver8x;
+    QuadrafuzzDSP fDSP;
+    QuadrafuzzFreewheel fFreewheel;
+    /* whether offline rendering is detected from the pace, as the state
+       asks, and as `run` last saw it */
+    std::atomic<bool> fOfflineDetection{false};
+    bool fDetecting = false;
 };
@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "QuadrafuzzTelemetry.hpp"
+#include <cmath>
+
+#if QUADRAFUZZ_TELEMETRY
+void QuadrafuzzTelemetry::endBlock(uint32_t frames, unsigned oversampling, bool bypassed, double sampleRate)
+{
+    uint64_t now = readCycles();
+
+    TelemetryRecord &rec = fCurrent;
+    rec.frames = frames;
+    rec.oversampling = oversampling;
+    rec.bypassed = bypassed;
+    rec.cycles = now - fBlockStartCycles;
+
+    if (fNsPerCycle == 0 || (fBlockCounter & 255) == 0)
+        calibrate(now);
+    rec.nanoseconds = (uint64_t)(rec.cycles * fNsPerCycle);
+
+    if (!fRing.push(rec))
+        fDropped.fetch_add(1, std::memory_order_relaxed);
+
+    if (frames == 0 || fNsPerCycle == 0)
+        return;
+
+    const double blockDuration = frames / sampleRate;
+    float load = 100 * (1e-9 * rec.nanoseconds) / blockDuration;
+    fBlockLoad = load;
+
+    // meter ballistics: 300 ms integration, 2 s peak hold
+    const double smoothTime = 0.3;
+    const double holdTime = 2.0;
+
+    if (blockDuration != fSmoothBlockDuration) {
+        fSmoothCoef = 1 - std::exp(-blockDuration / smoothTime);
+        fSmoothBlockDuration = blockDuration;
+    }
+
+    float smooth = fSmoothLoad;
+    smooth += (load - smooth) * fSmoothCoef;
+    fSmoothLoad = smooth;
+
+    float peak = fHeldPeak;
+    if (load >= peak) {
+        peak = load;
+        fPeakHoldTime = 0;
+    }
+    else if ((fPeakHoldTime += blockDuration) > holdTime)
+        peak = (smooth > load) ? smooth : load;
+    fHeldPeak = peak;
+
+    fLoad.store(smooth, std::memory_order_relaxed);
+    fPeakLoad.store(peak, std::memory_order_relaxed);
+}
+
+void QuadrafuzzTelemetry::calibrate(uint64_t cycles)
+{
+    uint64_t ns = readNanoseconds();
+    ++fCalibrationCount;
+
+    if (fCalibrationNs == 0) {
+        fCalibrationNs = ns;
+        fCalibrationCycles = cycles;
+        return;
+    }
+
+    // wait for at least 10 ms of measurement, for precision
+    if (ns - fCalibrationNs >= 10000000 && cycles > fCalibrationCycles)
+        fNsPerCycle = double(ns - fCalibrationNs) / double(cycles - fCalibrationCycles);
+}
+#endif
@@ -0,0 +1,186 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#include <cstdint>
+
+#ifndef QUADRAFUZZ_TELEMETRY
+#   define QUADRAFUZZ_TELEMETRY 1
+#endif
+
+/**
+ * One reading of the telemetry, for one call of `run`.
+ * The total time is in nanoseconds, the stages are in counter cycles.
+ */
+struct TelemetryRecord {
+    enum Stage { kStageUpsample, kStageFilters, kStageShaper, kStageDownsample, kStageCount };
+
+    uint32_t frames = 0;
+    /* the ratio of the active path, which resumes after a bypass */
+    uint32_t oversampling = 0;
+    /* the block was bypassed, and does not tell the cost of the ratio */
+    bool bypassed = false;
+    uint64_t nanoseconds = 0;
+    uint64_t cycles = 0;
+    uint64_t stageCycles[kStageCount] = {};
+};
+
+#if QUADRAFUZZ_TELEMETRY
+#include "SpscRing.hpp"
+#include <atomic>
+#include <ctime>
+#if defined(__i386__) || defined(__x86_64__)
+#   include <x86intrin.h>
+#endif
+
+/**
+ * Measurement of the DSP load on the audio thread.
+ *
+ * The audio thread brackets each block with `beginBlock` and `endBlock`,
+ * and optionally each stage with `stageBegin` and `stageEnd`. The records
+ * are queued in a lock-free ring, for a non-RT thread to `read` them.
+ *
+ * To keep the overhead low, blocks are timed with the cycle counter only,
+ * which is periodically calibrated against the monotonic clock, and the
+ * stages are timed on one block out of `kStageTimingInterval`.
+ */
+class QuadrafuzzTelemetry
+{
+public:
+    typedef TelemetryRecord::Stage Stage;
+
+    enum { kStageTimingInterval = 16 };
+
+    void setStageTiming(bool enable) { fStageTiming.store(enable, std::memory_order_relaxed); }
+    bool getStageTiming() const { return fStageTiming.load(std::memory_order_relaxed); }
+
+    void beginBlock()
+    {
+        fCurrent = TelemetryRecord();
+        // counted on every block, since the calibration goes by it too
+        uint32_t block = fBlockCounter++;
+        fStagesThisBlock = getStageTiming() && (block % kStageTimingInterval) == 0;
+        fBlockStartCycles = readCycles();
+    }
+
+    void endBlock(uint32_t frames, unsigned oversampling, bool bypassed, double sampleRate);
+
+    /* returns the start time of a stage, or 0 if stage timing is off */
+    uint64_t stageBegin() const
+    {
+        return fStagesThisBlock ? readCycles() : 0;
+    }
+
+    /* accounts the time since `t` to the stage, and restarts `t` */
+    void stageEnd(Stage stage, uint64_t &t)
+    {
+        if (fStagesThisBlock) {
+            uint64_t now = readCycles();
+            fCurrent.stageCycles[stage] += now - t;
+            t = now;
+        }
+    }
+
+    /* in percent of the block duration */
+    float getLoad() const { return fLoad.load(std::memory_order_relaxed); }
+    float getPeakLoad() const { return fPeakLoad.load(std::memory_order_relaxed); }
+    /* the load of the last block, on the audio thread, 0 until calibrated */
+    float getBlockLoad() const { return fBlockLoad; }
+    /* how many times the cycle counter was calibrated, on the audio thread */
+    uint32_t getCalibrationCount() const { return fCalibrationCount; }
+
+    /* non-RT side */
+    bool read(TelemetryRecord &record) { return fRing.pop(record); }
+    uint32_t getDroppedCount() const { return fDropped.load(std::memory_order_relaxed); }
+
+    static uint64_t readCycles()
+    {
+#if defined(__i386__) || defined(__x86_64__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t t;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+        return t;
+#else
+        return readNanoseconds();
+#endif
+    }
+
+    static uint64_t readNanoseconds()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+    }
+
+private:
+    void calibrate(uint64_t cycles);
+
+private:
+    TelemetryRecord fCurrent;
+    uint64_t fBlockStartCycles = 0;
+    uint32_t fBlockCounter = 0;
+    bool fStagesThisBlock = false;
+
+    double fNsPerCycle = 0;
+    uint64_t fCalibrationNs = 0;
+    uint64_t fCalibrationCycles = 0;
+    uint32_t fCalibrationCount = 0;
+
+    double fSmoothBlockDuration = 0;
+    float fSmoothCoef = 0;
+    float fSmoothLoad = 0;
+    float fBlockLoad = 0;
+    float fHeldPeak = 0;
+    double fPeakHoldTime = 0;
+
+    std::atomic<bool> fStageTiming{false};
+    std::atomic<float> fLoad{0};
+    std::atomic<float> fPeakLoad{0};
+    std::atomic<uint32_t> fDropped{0};
+
+    SpscRing<TelemetryRecord, 256> fRing;
+};
+#else
+/**
+ * Telemetry compiled out, every operation does nothing.
+ */
+class QuadrafuzzTelemetry
+{
+public:
+    typedef TelemetryRecord::Stage Stage;
+
+    void setStageTiming(bool) {}
+    bool getStageTiming() const { return false; }
+    void beginBlock() {}
+    void endBlock(uint32_t, unsigned, bool, double) {}
+    uint64_t stageBegin() const { return 0; }
+    void stageEnd(Stage, uint64_t &) {}
+    float getLoad() const { return 0; }
+    float getPeakLoad() const { return 0; }
+    float getBlockLoad() const { return 0; }
+    uint32_t getCalibrationCount() const { return 0; }
+    bool read(TelemetryRecord &) { return false; }
+    uint32_t getDroppedCount() const { return 0; }
+};
+#endif
@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "QuadrafuzzWorker.hpp"
+#include <algorithm>
+
+QuadrafuzzWorker &QuadrafuzzWorker::get()
+{
+    static QuadrafuzzWorker worker;
+    return worker;
+}
+
+QuadrafuzzWorker::~QuadrafuzzWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fQuit = true;
+    }
+    fCondition.notify_one();
+    if (fThread.joinable())
+        fThread.join();
+}
+
+void QuadrafuzzWorker::post(const void *owner, std::function<void()> job, Clock::duration delay)
+{
+    Job entry{owner, Clock::now() + delay, std::move(job)};
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    // the thread starts with the first job, so the processes which never
+    // reconfigure an instance do not have it
+    if (!fThread.joinable())
+        fThread = std::thread([this]() { process(); });
+
+    // after the jobs which are due at the same time, to keep their order
+    auto pos = std::find_if(fJobs.begin(), fJobs.end(), [&entry](const Job &other) { return other.due > entry.due; });
+    fJobs.insert(pos, std::move(entry));
+    fCondition.notify_one();
+}
+
+void QuadrafuzzWorker::wait(const void *owner)
+{
+    Clock::time_point now = Clock::now();
+    std::unique_lock<std::mutex> lock(fMutex);
+    fIdle.wait(lock, [this, owner, now]() { return fRunningOwner != owner && !hasDueJob(owner, now); });
+}
+
+void QuadrafuzzWorker::cancel(const void *owner)
+{
+    std::unique_lock<std::mutex> lock(fMutex);
+    // the job which runs may post others for its owner, which go as well
+    for (;;) {
+        fJobs.remove_if([owner](const Job &job) { return job.owner == owner; });
+        if (fRunningOwner != owner)
+            break;
+        fIdle.wait(lock, [this, owner]() { return fRunningOwner != owner; });
+    }
+}
+
+bool QuadrafuzzWorker::hasDueJob(const void *owner, Clock::time_point time) const
+{
+    for (const Job &job : fJobs) {
+        if (job.due > time)
+            break;
+        if (job.owner == owner)
+            return true;
+    }
+    return false;
+}
+
+void QuadrafuzzWorker::process()
+{
+    std::unique_lock<std::mutex> lock(fMutex);
+    while (!fQuit) {
+        if (fJobs.empty()) {
+            fCondition.wait(lock);
+            continue;
+        }
+        // a copy of the due time, since `cancel` may drop the job meanwhile
+        Clock::time_point due = fJobs.front().due;
+        if (due > Clock::now()) {
+            fCondition.wait_until(lock, due);
+            continue;
+        }
+
+        Job job = std::move(fJobs.front());
+        fJobs.pop_front();
+        fRunningOwner = job.owner;
+        lock.unlock();
+        job.function();
+        lock.lock();
+        fRunningOwner = nullptr;
+        fIdle.notify_all();
+    }
+}
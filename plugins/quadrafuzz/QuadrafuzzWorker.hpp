@@ -0,0 +1,83 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#pragma once
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+
+/**
+ * A background thread for the work which must not run on the audio thread,
+ * such as allocations, shared by the instances of the process.
+ *
+ * Jobs run one at a time, in the order of their due time. Each is tagged
+ * with its owner, usually an instance, which must `cancel` its jobs before
+ * it goes away.
+ *
+ * Jobs are posted from non-RT threads: posting allocates and takes a lock.
+ */
+class QuadrafuzzWorker
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static QuadrafuzzWorker &get();
+
+    QuadrafuzzWorker() = default;
+    ~QuadrafuzzWorker();
+
+    /* runs `job` on the worker, after `delay` */
+    void post(const void *owner, std::function<void()> job, Clock::duration delay = Clock::duration::zero());
+
+    /* waits for the jobs of `owner` which are due, and the one which runs */
+    void wait(const void *owner);
+
+    /* drops the jobs of `owner`, and waits for the one which runs, and
+       drops the jobs which it posted */
+    void cancel(const void *owner);
+
+private:
+    struct Job {
+        const void *owner;
+        Clock::time_point due;
+        std::function<void()> function;
+    };
+
+    void process();
+    bool hasDueJob(const void *owner, Clock::time_point time) const;
+
+    std::mutex fMutex;
+    std::condition_variable fCondition;
+    std::condition_variable fIdle;
+    std::list<Job> fJobs;
+    const void *fRunningOwner = nullptr;
+    bool fQuit = false;
+    std::thread fThread;
+
+    QuadrafuzzWorker(const QuadrafuzzWorker &) = delete;
+    QuadrafuzzWorker &operator=(const QuadrafuzzWorker &) = delete;
+};
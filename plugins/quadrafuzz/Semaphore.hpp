@@ -0,0 +1,99 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#if defined(_WIN32)
+#   include <windows.h>
+#   include <climits>
+#elif defined(__APPLE__)
+#   include <dispatch/dispatch.h>
+#else
+#   include <semaphore.h>
+#   include <cerrno>
+#endif
+
+/**
+ * Counting semaphore, whose `post` may be called on the audio thread: it
+ * does not take a lock, and on Linux and macOS, it only enters the kernel
+ * when a thread waits, unlike the signal of a condition variable.
+ */
+class Semaphore
+{
+public:
+    Semaphore()
+    {
+#if defined(_WIN32)
+        fHandle = CreateSemaphoreW(nullptr, 0, LONG_MAX, nullptr);
+#elif defined(__APPLE__)
+        fHandle = dispatch_semaphore_create(0);
+#else
+        sem_init(&fHandle, 0, 0);
+#endif
+    }
+
+    ~Semaphore()
+    {
+#if defined(_WIN32)
+        CloseHandle(fHandle);
+#elif defined(__APPLE__)
+        dispatch_release(fHandle);
+#else
+        sem_destroy(&fHandle);
+#endif
+    }
+
+    void post()
+    {
+#if defined(_WIN32)
+        ReleaseSemaphore(fHandle, 1, nullptr);
+#elif defined(__APPLE__)
+        dispatch_semaphore_signal(fHandle);
+#else
+        sem_post(&fHandle);
+#endif
+    }
+
+    void wait()
+    {
+#if defined(_WIN32)
+        WaitForSingleObject(fHandle, INFINITE);
+#elif defined(__APPLE__)
+        dispatch_semaphore_wait(fHandle, DISPATCH_TIME_FOREVER);
+#else
+        while (sem_wait(&fHandle) == -1 && errno == EINTR)
+            continue;
+#endif
+    }
+
+private:
+#if defined(_WIN32)
+    HANDLE fHandle;
+#elif defined(__APPLE__)
+    dispatch_semaphore_t fHandle;
+#else
+    sem_t fHandle;
+#endif
+
+    Semaphore(const Semaphore &) = delete;
+    Semaphore &operator=(const Semaphore &) = delete;
+};
@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free ring buffer, for a single producer and a single consumer.
+ * The capacity must be a power of two.
+ */
+template <class T, uint32_t Capacity>
+class SpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "The capacity must be a power of two");
+
+public:
+    bool push(const T &value)
+    {
+        uint32_t w = fWriteIndex.load(std::memory_order_relaxed);
+        uint32_t r = fReadIndex.load(std::memory_order_acquire);
+        if (w - r == Capacity)
+            return false;
+        fData[w & (Capacity - 1)] = value;
+        fWriteIndex.store(w + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        uint32_t r = fReadIndex.load(std::memory_order_relaxed);
+        uint32_t w = fWriteIndex.load(std::memory_order_acquire);
+        if (w == r)
+            return false;
+        value = fData[r & (Capacity - 1)];
+        fReadIndex.store(r + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t size() const
+    {
+        return fWriteIndex.load(std::memory_order_acquire) - fReadIndex.load(std::memory_order_acquire);
+    }
+
+private:
+    T fData[Capacity];
+    // keep the indices on separate cache lines, without requiring an
+    // over-aligned allocation of the containing object
+    char fPad1[64];
+    std::atomic<uint32_t> fWriteIndex{0};
+    char fPad2[64];
+    std::atomic<uint32_t> fReadIndex{0};
+};
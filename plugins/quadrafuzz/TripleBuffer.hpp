@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2019 Jean Pierre Cimalando
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice (including the next
+paragraph) shall be included in all copies or substantial portions of the
+Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+#include <atomic>
+
+/**
+ * Lock-free exchange of the latest value of some state, from one writer
+ * thread to one reader thread. Neither side ever waits.
+ *
+ * The writer fills the write buffer completely, and publishes it.
+ * The reader calls `update` to adopt the latest published buffer, if any.
+ */
+template <class T>
+class TripleBuffer
+{
+public:
+    /* sets all the buffers, while no other thread accesses them */
+    void reset(const T &value)
+    {
+        for (T &buffer : fBuffers)
+            buffer = value;
+        fBack = 0;
+        fMiddle.store(1, std::memory_order_relaxed);
+        fFront = 2;
+    }
+
+    /* writer side */
+    T &getWriteBuffer()
+    {
+        return fBuffers[fBack];
+    }
+
+    void publish()
+    {
+        unsigned previous = fMiddle.exchange(fBack | kDirty, std::memory_order_acq_rel);
+        fBack = previous & kIndexMask;
+    }
+
+    /* reader side, returns true if a new value was adopted */
+    bool update()
+    {
+        if (!(fMiddle.load(std::memory_order_relaxed) & kDirty))
+            return false;
+        unsigned previous = fMiddle.exchange(fFront, std::memory_order_acq_rel);
+        fFront = previous & kIndexMask;
+        return true;
+    }
+
+    const T &getReadBuffer() const
+    {
+        return fBuffers[fFront];
+    }
+
+private:
+    enum { kIndexMask = 3, kDirty = 4 };
+
+    T fBuffers[3];
+    unsigned fBack = 0;
+    std::atomic<unsigned> fMiddle{1};
+    unsigned fFront = 2;
+};
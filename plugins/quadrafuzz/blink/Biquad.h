@@ -73,6 +73,24 @@ class Biquad {
   // Resets filter state
   void reset();
 
+  // The normalized coefficients, to copy a filter response to another
+  // filter without computing it again.
+  struct Coefficients {
+    double b0, b1, b2, a1, a2;
+  };
+
+  Coefficients getCoefficients() const {
+    return Coefficients{m_b0, m_b1, m_b2, m_a1, m_a2};
+  }
+
+  void setCoefficients(const Coefficients& c) {
+    m_b0 = c.b0;
+    m_b1 = c.b1;
+    m_b2 = c.b2;
+    m_a1 = c.a1;
+    m_a2 = c.a2;
+  }
+
   // Filter response at a set of n frequencies. The magnitude and
   // phase response are returned in magResponse and phaseResponse.
   // The phase response is in radians.